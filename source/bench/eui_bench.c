@@ -0,0 +1,286 @@
+/*
+MIT License
+
+Copyright (c) 2023-2024 erysdren (it/she/they)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * frame time microbenchmarks for eui, drawing into a host buffer
+ * without sdl, run them all or name the ones to run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "eui.h"
+
+#define NAME "eui-bench"
+
+#define WIDTH (640)
+#define HEIGHT (480)
+
+/* one benchmark case */
+typedef struct bench_t {
+	const char *name;
+	int frames;
+	void (*setup)(void);
+	void (*frame)(int i);
+} bench_t;
+
+static unsigned char pixels[WIDTH * HEIGHT];
+
+/* a line of every printable glyph, wide enough to cover the screen */
+static char text_line[WIDTH / 8 + 1];
+
+/* microseconds on a monotonic clock */
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+/*
+ *
+ * text, a full screen of glyphs per frame
+ *
+ */
+
+static void text_setup(void)
+{
+	int i;
+
+	for (i = 0; i < WIDTH / 8; i++)
+		text_line[i] = (char)(33 + (i * 7) % 90);
+	text_line[WIDTH / 8] = '\0';
+
+	eui_init(WIDTH, HEIGHT, 8, WIDTH, pixels);
+}
+
+static void text_frame(int font)
+{
+	int y, h;
+
+	h = font == EUI_FONT_8X8 ? 8 : 14;
+
+	/* every glyph gets drawn, not just the tiles that changed */
+	eui_context_invalidate();
+
+	eui_context_begin();
+	eui_font_set(font);
+	eui_frame_align_set(EUI_ALIGN_START, EUI_ALIGN_START);
+	for (y = 0; y + h <= HEIGHT; y += h)
+		eui_draw_text(0, y, 15, text_line);
+	eui_context_end();
+}
+
+static void text_8x8_frame(int i)
+{
+	(void)i;
+	text_frame(EUI_FONT_8X8);
+}
+
+static void text_8x14_frame(int i)
+{
+	(void)i;
+	text_frame(EUI_FONT_8X14);
+}
+
+/*
+ *
+ * sort, a queue of 8128 small drawcmds in 64 frames
+ *
+ */
+
+#define SORT_FRAMES (64)
+#define SORT_DRAWCMDS (127)
+
+static unsigned int sort_seed;
+
+/* xorshift, so every frame pushes the same queue */
+static unsigned int sort_random(void)
+{
+	sort_seed ^= sort_seed << 13;
+	sort_seed ^= sort_seed >> 17;
+	sort_seed ^= sort_seed << 5;
+
+	return sort_seed;
+}
+
+static void sort_setup(void)
+{
+	eui_init(WIDTH, HEIGHT, 8, WIDTH, pixels);
+}
+
+/* with mixed set, frames get scattered z values instead of push order */
+static void sort_frame(int mixed)
+{
+	int f, i;
+
+	sort_seed = 12345;
+
+	eui_context_begin();
+	for (f = 0; f < SORT_FRAMES; f++)
+	{
+		eui_frame_push(sort_random() % (WIDTH - 40), sort_random() % (HEIGHT - 20), 40, 20);
+		if (mixed)
+			eui_frame_z_set((int)(sort_random() % 2000) * SORT_FRAMES + f - 60000);
+
+		for (i = 0; i < SORT_DRAWCMDS; i++)
+		{
+			switch (i % 3)
+			{
+				case 0: eui_draw_box(sort_random() % 40, sort_random() % 20, 2, 2, sort_random() & 0xFF); break;
+				case 1: eui_draw_text(sort_random() % 40, sort_random() % 20, 15, "a"); break;
+				default: eui_draw_box(sort_random() % 40, sort_random() % 20, 1, 1, sort_random() & 0xFF); break;
+			}
+		}
+
+		eui_frame_pop();
+	}
+	eui_context_end();
+}
+
+static void sort_monotonic_frame(int i)
+{
+	(void)i;
+	sort_frame(0);
+}
+
+static void sort_mixed_frame(int i)
+{
+	(void)i;
+	sort_frame(1);
+}
+
+/*
+ *
+ * timeline, a screen of posts that is idle or has one row changing
+ *
+ */
+
+static void timeline_setup(void)
+{
+	eui_init(WIDTH, HEIGHT, 8, WIDTH, pixels);
+}
+
+static void timeline_frame(int changing)
+{
+	char headline[64];
+	int i, y;
+
+	eui_context_begin();
+	eui_screen_clear(0x01);
+	for (i = 0, y = 4; i < 12; i++, y += 40)
+	{
+		eui_draw_box(8, y, WIDTH - 16, 32, 0x0F);
+		eui_draw_text(16, y + 4, 0x01, "@someproject");
+		sprintf(headline, "post headline number %d, a little longer than that", i == 5 ? i + changing : i);
+		eui_draw_text(16, y + 18, 0x00, headline);
+	}
+	eui_context_end();
+}
+
+static void timeline_idle_frame(int i)
+{
+	(void)i;
+	timeline_frame(0);
+}
+
+static void timeline_changing_frame(int i)
+{
+	timeline_frame(i);
+}
+
+/*
+ *
+ * main
+ *
+ */
+
+static const bench_t benches[] = {
+	{"text-8x8", 500, text_setup, text_8x8_frame},
+	{"text-8x14", 500, text_setup, text_8x14_frame},
+	{"sort-monotonic", 500, sort_setup, sort_monotonic_frame},
+	{"sort-mixed", 500, sort_setup, sort_mixed_frame},
+	{"timeline-idle", 2000, timeline_setup, timeline_idle_frame},
+	{"timeline-changing", 2000, timeline_setup, timeline_changing_frame}
+};
+
+#define NUM_BENCHES ((int)(sizeof(benches) / sizeof(benches[0])))
+
+/* run one case and print its average frame time */
+static void bench_run(const bench_t *bench)
+{
+	double start, end;
+	int i;
+
+	bench->setup();
+
+	/* the first frame pays for one-off setup */
+	bench->frame(0);
+
+	start = bench_now();
+	for (i = 0; i < bench->frames; i++)
+		bench->frame(i);
+	end = bench_now();
+
+	printf("%-24s %10.2f us/frame\n", bench->name, (end - start) / bench->frames);
+
+	eui_quit();
+}
+
+int main(int argc, char **argv)
+{
+	int i, j, found;
+
+	if (argc < 2)
+	{
+		for (i = 0; i < NUM_BENCHES; i++)
+			bench_run(&benches[i]);
+		return EXIT_SUCCESS;
+	}
+
+	for (j = 1; j < argc; j++)
+	{
+		found = 0;
+		for (i = 0; i < NUM_BENCHES; i++)
+		{
+			if (strcmp(argv[j], benches[i].name) == 0)
+			{
+				bench_run(&benches[i]);
+				found = 1;
+			}
+		}
+
+		if (!found)
+		{
+			fprintf(stderr, "%s: no benchmark named %s\n", NAME, argv[j]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
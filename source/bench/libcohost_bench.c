@@ -0,0 +1,466 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * microbenchmarks for libcohost, response decoding over a synthetic page
+ * of posts built in memory and request bursts against a stand-in server,
+ * run them all or name the ones to run
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "thirdparty/cJSON.h"
+
+#include "libcohost.h"
+#include "libcohost_json.h"
+
+#define NAME "cohost-bench"
+
+/* posts on the synthetic page, and how many projects wrote them */
+#define PAGE_POSTS (1000)
+#define PAGE_PROJECTS (37)
+
+/* curl hands over bodies in chunks of about this size */
+#define CHUNK_SIZE (16 * 1024)
+
+/* pages asked for at once by the network cases, twice the handle pool */
+#define BURST_REQUESTS (LIBCOHOST_MAX_HANDLES * 2)
+
+/* longest url the network cases are pointed at */
+#define URL_LEN (1024)
+
+/* one benchmark case */
+typedef struct bench_t {
+	const char *name;
+	int iterations;
+	void (*setup)(void);
+	void (*run)(void);
+	int requests; /* per run for the network cases, 0 for the page ones */
+} bench_t;
+
+static libcohost_buffer_t page;
+static unsigned long items;
+
+/* network cases fetch pages of this, never from the live service */
+static const char *url;
+
+/* microseconds on a monotonic clock */
+static double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+/* append formatted text to the page */
+static void page_printf(const char *fmt, ...)
+{
+	static char line[4096];
+	va_list list;
+	int len;
+
+	va_start(list, fmt);
+	len = vsnprintf(line, sizeof(line), fmt, list);
+	va_end(list);
+
+	if (len < 0 || (size_t)len >= sizeof(line) || libcohost_buffer_append(&page, line, len) != LIBCOHOST_RESULT_OK)
+	{
+		fprintf(stderr, "%s: couldn't build the page\n", NAME);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* a page shaped like the posts of a project, with escapes and nesting in the bodies */
+static void page_build(void)
+{
+	int i, j, project;
+
+	if (page.len)
+		return;
+
+	page_printf("{\"nItems\":%d,\"nPages\":1,\"items\":[", PAGE_POSTS);
+	for (i = 0; i < PAGE_POSTS; i++)
+	{
+		project = i % PAGE_PROJECTS;
+
+		page_printf("%s{\"postId\":%d,\"headline\":\"post %d, \\\"quoted\\\" {not a brace}\",", i ? "," : "", 100000 + i, i);
+		page_printf("\"publishedAt\":\"2024-03-%02dT12:%02d:00.000Z\",\"state\":1,\"numComments\":%d,", 1 + i % 28, i % 60, i % 13);
+		page_printf("\"transparentShareOfPostId\":%s,\"pinned\":false,\"commentsLocked\":false,\"sharesLocked\":false,", i % 5 ? "null" : "99");
+		page_printf("\"singlePostPageUrl\":\"https://cohost.org/project%d/post/%d-post-%d\",", project, 100000 + i, i);
+		page_printf("\"effectiveAdultContent\":%s,\"isLiked\":%s,\"isEditor\":false,", i % 11 ? "false" : "true", i % 3 ? "false" : "true");
+
+		page_printf("\"plainTextBody\":\"");
+		for (j = 0; j < 4 + i % 9; j++)
+			page_printf("line %d of post %d has some words, a tab\\t and a newline\\n ", j, i);
+		page_printf("\",");
+
+		page_printf("\"tags\":[");
+		for (j = 0; j < i % 6; j++)
+			page_printf("%s\"tag %d\"", j ? "," : "", (i + j) % 50);
+		page_printf("],");
+
+		page_printf("\"postingProject\":{\"projectId\":%d,\"handle\":\"project%d\",\"displayName\":\"Project \\u00e9 %d\",", 500 + project, project, project);
+		page_printf("\"avatarURL\":\"https://staging.cohostcdn.org/avatar/%d.png\",\"privacy\":\"public\",", project);
+		page_printf("\"askSettings\":{\"enabled\":%s,\"allowAnon\":false}},", project % 2 ? "true" : "false");
+
+		page_printf("\"blocks\":[{\"type\":\"markdown\",\"markdown\":{\"content\":\"post %d [link](https://example.org/%d)\"}}]}", i, i);
+	}
+	page_printf("]}");
+}
+
+/* use scanner level, saying so if the cpu can't */
+static void scan_use(int level)
+{
+	if (libcohost_json_scan_set(level) != level)
+		fprintf(stderr, "%s: scanner level %d isn't supported here, timing a lower one\n", NAME, level);
+}
+
+/*
+ *
+ * parse, the whole page as one tree or one element at a time
+ *
+ */
+
+/* with the scanner libcohost_init() picks */
+static void parse_setup(void)
+{
+	page_build();
+	libcohost_json_scan_set(LIBCOHOST_JSON_SCAN_AVX2);
+}
+
+static void item_count(void *json, void *user)
+{
+	(void)json;
+	(void)user;
+	items++;
+}
+
+static void parse_tree_run(void)
+{
+	cJSON *json, *item;
+
+	json = cJSON_ParseWithLength(page.data, page.len);
+	cJSON_ArrayForEach(item, cJSON_GetObjectItem(json, "items"))
+		items++;
+	cJSON_Delete(json);
+}
+
+static void parse_stream_run(void)
+{
+	libcohost_json_stream_t stream;
+	size_t pos, len;
+
+	libcohost_json_stream_init(&stream, "items", item_count, NULL);
+	for (pos = 0; pos < page.len; pos += len)
+	{
+		len = page.len - pos < CHUNK_SIZE ? page.len - pos : CHUNK_SIZE;
+		libcohost_json_stream_feed(&stream, page.data + pos, len);
+	}
+	libcohost_json_stream_free(&stream);
+}
+
+/*
+ *
+ * handles, pull every author handle out of the page
+ *
+ */
+
+static void handles_tree_run(void)
+{
+	cJSON *json, *item, *handle;
+
+	json = cJSON_ParseWithLength(page.data, page.len);
+	cJSON_ArrayForEach(item, cJSON_GetObjectItem(json, "items"))
+	{
+		handle = cJSON_GetObjectItem(cJSON_GetObjectItem(item, "postingProject"), "handle");
+		if (cJSON_IsString(handle))
+			items++;
+	}
+	cJSON_Delete(json);
+}
+
+/* the index takes the response over, so each run starts from a copy as a request would */
+static void handles_index_run(void)
+{
+	libcohost_json_index_t index;
+	libcohost_buffer_t raw;
+	char handle[64];
+	int i;
+
+	memset(&raw, 0, sizeof(raw));
+	libcohost_buffer_append(&raw, page.data, page.len);
+
+	libcohost_json_index_build(&index, "items", &raw);
+	for (i = 0; i < index.num_items; i++)
+		if (libcohost_json_index_string(&index, i, "postingProject.handle", handle, sizeof(handle)) >= 0)
+			items++;
+
+	libcohost_json_index_free(&index);
+	libcohost_buffer_free(&raw);
+}
+
+/*
+ *
+ * split, find the elements without parsing them, per scanner
+ *
+ */
+
+static void item_span(size_t offset, size_t len, void *user)
+{
+	(void)offset;
+	(void)len;
+	(void)user;
+	items++;
+}
+
+static void split_scalar_setup(void)
+{
+	page_build();
+	scan_use(LIBCOHOST_JSON_SCAN_SCALAR);
+}
+
+static void split_sse2_setup(void)
+{
+	page_build();
+	scan_use(LIBCOHOST_JSON_SCAN_SSE2);
+}
+
+static void split_avx2_setup(void)
+{
+	page_build();
+	scan_use(LIBCOHOST_JSON_SCAN_AVX2);
+}
+
+static void split_run(void)
+{
+	libcohost_json_stream_t stream;
+	size_t pos, len;
+
+	libcohost_json_stream_init(&stream, "items", NULL, NULL);
+	stream.span_callback = item_span;
+	for (pos = 0; pos < page.len; pos += len)
+	{
+		len = page.len - pos < CHUNK_SIZE ? page.len - pos : CHUNK_SIZE;
+		libcohost_json_stream_feed(&stream, page.data + pos, len);
+	}
+	libcohost_json_stream_free(&stream);
+}
+
+/*
+ *
+ * burst, a cold session fetching a run of pages at once over each http version
+ *
+ */
+
+static int burst_version;
+static char burst_urls[BURST_REQUESTS][URL_LEN];
+
+static void burst_setup(void)
+{
+	int i;
+
+	/* distinct urls, so no two requests could ever share a transfer */
+	for (i = 0; i < BURST_REQUESTS; i++)
+	{
+		if (snprintf(burst_urls[i], URL_LEN, "%s%cpage=%d", url, strchr(url, '?') ? '&' : '?', i) >= URL_LEN)
+		{
+			fprintf(stderr, "%s: url %s is too long\n", NAME, url);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static void burst_http1_setup(void)
+{
+	burst_setup();
+	burst_version = LIBCOHOST_HTTP_1_1;
+}
+
+static void burst_http2_setup(void)
+{
+	burst_setup();
+	burst_version = LIBCOHOST_HTTP_2;
+}
+
+static void burst_done(libcohost_request_t *request, void *user)
+{
+	(void)user;
+
+	if (request->result == LIBCOHOST_RESULT_OK && request->status == 200)
+		items++;
+}
+
+/* connections are set up inside the timed run, as they are when a page is opened */
+static void burst_run(void)
+{
+	libcohost_session_t session;
+	int i;
+
+	if (libcohost_session_init(&session) != LIBCOHOST_RESULT_OK)
+	{
+		fprintf(stderr, "%s: couldn't setup a session\n", NAME);
+		exit(EXIT_FAILURE);
+	}
+	libcohost_session_http_version_set(&session, burst_version);
+
+	for (i = 0; i < BURST_REQUESTS; i++)
+		libcohost_request_submit(&session, burst_urls[i], burst_done, NULL);
+	while (libcohost_poll(&session, 100));
+
+	libcohost_session_destroy(&session);
+}
+
+/*
+ *
+ * main
+ *
+ */
+
+static const bench_t benches[] = {
+	{"parse-tree", 200, parse_setup, parse_tree_run, 0},
+	{"parse-stream", 200, parse_setup, parse_stream_run, 0},
+	{"handles-tree", 200, parse_setup, handles_tree_run, 0},
+	{"handles-index", 200, parse_setup, handles_index_run, 0},
+	{"split-scalar", 1000, split_scalar_setup, split_run, 0},
+	{"split-sse2", 1000, split_sse2_setup, split_run, 0},
+	{"split-avx2", 1000, split_avx2_setup, split_run, 0},
+	{"burst-http1", 20, burst_http1_setup, burst_run, BURST_REQUESTS},
+	{"burst-http2", 20, burst_http2_setup, burst_run, BURST_REQUESTS}
+};
+
+#define NUM_BENCHES ((int)(sizeof(benches) / sizeof(benches[0])))
+
+/* run one case and print its average time */
+static void bench_run(const bench_t *bench)
+{
+	double start, end;
+	int i;
+
+	if (bench->requests && url == NULL)
+	{
+		printf("%-24s %10s (needs -u url)\n", bench->name, "skipped");
+		return;
+	}
+
+	bench->setup();
+
+	/* warm up, and check every case sees the whole page or every response */
+	items = 0;
+	bench->run();
+	if (bench->requests && items != (unsigned long)bench->requests)
+		fprintf(stderr, "%s: %s got %lu of %d pages\n", NAME, bench->name, items, bench->requests);
+	else if (!bench->requests && items != PAGE_POSTS)
+		fprintf(stderr, "%s: %s saw %lu of %d posts\n", NAME, bench->name, items, PAGE_POSTS);
+
+	start = bench_now();
+	for (i = 0; i < bench->iterations; i++)
+		bench->run();
+	end = bench_now();
+
+	if (bench->requests)
+		printf("%-24s %10.2f us/burst of %d\n", bench->name, (end - start) / bench->iterations, bench->requests);
+	else
+		printf("%-24s %10.2f us/page %8.1f MB/s\n", bench->name, (end - start) / bench->iterations,
+			(double)page.len * bench->iterations / (end - start));
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: " NAME " [-u url] [benchmark...]\n"
+		"  -u url  run the burst cases against a page of a stand-in server, like https://127.0.0.1:8443/posts.json\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	int i, j, c, found;
+
+	while ((c = getopt(argc, argv, "u:")) != -1)
+	{
+		switch (c)
+		{
+			case 'u': url = optarg; break;
+			default: usage();
+		}
+	}
+
+	if (libcohost_init() != LIBCOHOST_RESULT_OK)
+	{
+		fprintf(stderr, "%s: couldn't initialize libcohost\n", NAME);
+		return EXIT_FAILURE;
+	}
+
+	if (optind == argc)
+	{
+		for (i = 0; i < NUM_BENCHES; i++)
+			bench_run(&benches[i]);
+	}
+
+	for (j = optind; j < argc; j++)
+	{
+		found = 0;
+		for (i = 0; i < NUM_BENCHES; i++)
+		{
+			if (strcmp(argv[j], benches[i].name) == 0)
+			{
+				bench_run(&benches[i]);
+				found = 1;
+			}
+		}
+
+		if (!found)
+		{
+			fprintf(stderr, "%s: no benchmark named %s\n", NAME, argv[j]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	libcohost_buffer_free(&page);
+	libcohost_quit();
+
+	return EXIT_SUCCESS;
+}
@@ -33,6 +33,7 @@ SOFTWARE.
 #include <stdarg.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <stdint.h>
 
 #include "eui.h"
 
@@ -47,7 +48,7 @@ enum {
 	DRAW_NONE,
 	DRAW_PIXEL,
 	DRAW_BOX,
-	DRAW_GLYPH,
+	DRAW_TEXT_RUN,
 	DRAW_BITMAP
 };
 
@@ -64,6 +65,18 @@ typedef struct font_t {
 	unsigned char *bitmap;
 } font_t;
 
+/* font rows expanded for the current bpp, plus colored copies of them */
+typedef struct atlas_t {
+	font_t *font;
+	uint64_t *masks; /* 256 * glyph_h rows */
+	struct {
+		unsigned int color;
+		unsigned long used;
+		uint64_t *rows; /* masks with the color filled in */
+	} colors[EUI_ATLAS_COLORS];
+	unsigned long clock;
+} atlas_t;
+
 /* draw command */
 typedef struct drawcmd_t {
 	int type;
@@ -71,9 +84,10 @@ typedef struct drawcmd_t {
 	union {
 		struct { int x; int y; unsigned int color; } pixel;
 		struct { int x; int y; int w; int h; unsigned int color; } box;
-		struct { int x; int y; unsigned int glyph; unsigned int color; font_t *font; } glyph;
-		struct { int x; int y; int w; int h; int bpp; int pitch; void *pixels; } bitmap;
+		struct { int x; int y; int start; int len; unsigned int color; font_t *font; } text;
+		struct { int x; int y; int w; int h; int bpp; int pitch; void *pixels; int versioned; unsigned int generation; } bitmap;
 	} cmd;
+	struct { int x0, y0, x1, y1; } bounds; /* on screen, filled in at context end */
 } drawcmd_t;
 
 /* frame */
@@ -637,6 +651,10 @@ static struct {
 	drawcmd_t drawcmds[EUI_MAX_DRAWCMDS];
 	int num_drawcmds;
 	int drawcmds_order[EUI_MAX_DRAWCMDS];
+	uint64_t drawcmds_keys[2][EUI_MAX_DRAWCMDS];
+
+	char text[EUI_MAX_TEXT];
+	int text_len;
 
 	int w;
 	int h;
@@ -646,6 +664,22 @@ static struct {
 
 	font_t *font;
 	int fontnum;
+	atlas_t atlases[2];
+
+	/* area the rasterizers may write to */
+	struct { int x0, y0, x1, y1; } clip;
+
+	/* change tracking */
+	int drawing;
+	int clear;
+	unsigned int clear_color;
+	int tiles_w, tiles_h;
+	uint64_t *tiles[2]; /* hashes of this context and the last one */
+	int tiles_valid;
+	eui_rect_t *dirty;
+	eui_rect_t *rects; /* dirty, or screen when everything was redrawn */
+	int num_dirty;
+	eui_rect_t screen;
 
 	void (*set_pixel)(int x, int y, unsigned int color);
 	void (*set_box)(int x, int y, int w, int h, unsigned int color);
@@ -793,32 +827,320 @@ static void set_box_8(int x, int y, int w, int h, unsigned int color)
 	}
 }
 
-static void set_glyph_font_bitmap(int x, int y, unsigned int glyph, unsigned int color, font_t *font)
+/* font rows expanded to pixel masks, font bit n is the nth pixel from the left */
+static unsigned char glyph_masks_1[256];
+static uint16_t glyph_masks_2[256];
+static uint32_t glyph_masks_4[256];
+static uint64_t glyph_masks_8[256];
+
+static void glyph_masks_init(void)
 {
-	int xx, yy, xxx, yyy;
-	unsigned char *bitmap;
+	unsigned char bytes[8];
+	int row, n;
+
+	for (row = 0; row < 256; row++)
+	{
+		glyph_masks_1[row] = 0;
+		glyph_masks_2[row] = 0;
+		glyph_masks_4[row] = 0;
+		memset(bytes, 0, sizeof(bytes));
+
+		for (n = 0; n < 8; n++)
+		{
+			if (!(row & 1 << n))
+				continue;
+
+			glyph_masks_1[row] |= 0x80 >> n;
+			glyph_masks_2[row] |= 0xC000 >> (2 * n);
+			glyph_masks_4[row] |= (uint32_t)0xF0000000 >> (4 * n);
+			bytes[n] = 0xFF;
+		}
+
+		/* byte n is pixel n whatever the endianness */
+		memcpy(&glyph_masks_8[row], bytes, sizeof(bytes));
+	}
+}
+
+/* clip a glyph to the screen once, returns EUI_FALSE if none of it is visible */
+/* x moves to the first visible column, skip is how many columns were cut off */
+static int glyph_clip(int *x, int y, font_t *font, int *y0, int *y1, unsigned int *cols, int *skip)
+{
+	int x0, x1;
+
+	x0 = *x < state.clip.x0 ? state.clip.x0 - *x : 0;
+	x1 = *x + font->glyph_w > state.clip.x1 ? state.clip.x1 - *x : font->glyph_w;
+	*y0 = y < state.clip.y0 ? state.clip.y0 - y : 0;
+	*y1 = y + font->glyph_h > state.clip.y1 ? state.clip.y1 - y : font->glyph_h;
+
+	if (x0 >= x1 || *y0 >= *y1)
+		return EUI_FALSE;
+
+	*cols = (0xFFu >> (8 - x1)) & (0xFFu << x0);
+	*skip = x0;
+	*x += x0;
+
+	return EUI_TRUE;
+}
+
+/* expand a font row to a mask for the current bpp, packed pixels left aligned */
+static uint64_t glyph_row_mask(unsigned int row)
+{
+	switch (state.bpp)
+	{
+		case 1: return (uint64_t)glyph_masks_1[row] << 56;
+		case 2: return (uint64_t)glyph_masks_2[row] << 48;
+		case 4: return (uint64_t)glyph_masks_4[row] << 32;
+		default: return glyph_masks_8[row];
+	}
+}
+
+/* color repeated across 64 bits of pixels */
+static uint64_t glyph_fill(unsigned int color)
+{
+	switch (state.bpp)
+	{
+		case 1: return (uint64_t)(color & 0x1) * 0xFFFFFFFFFFFFFFFFULL;
+		case 2: return (uint64_t)(color & 0x3) * 0x5555555555555555ULL;
+		case 4: return (uint64_t)(color & 0xF) * 0x1111111111111111ULL;
+		default: return (uint64_t)(color & 0xFF) * 0x0101010101010101ULL;
+	}
+}
+
+/* free every atlas, they only hold for one bpp */
+static void atlas_free_all(void)
+{
+	atlas_t *atlas;
+	int i, c;
+
+	for (i = 0; i < (int)(sizeof(state.atlases) / sizeof(state.atlases[0])); i++)
+	{
+		atlas = &state.atlases[i];
+		for (c = 0; c < EUI_ATLAS_COLORS; c++)
+			free(atlas->colors[c].rows);
+		free(atlas->masks);
+		memset(atlas, 0, sizeof(atlas_t));
+	}
+}
+
+/* get the expanded rows of a font in a color, building them on first use */
+/* returns NULL if there's no memory for them */
+static const uint64_t *atlas_rows(font_t *font, unsigned int color, const uint64_t **masks)
+{
+	atlas_t *atlas = NULL;
+	uint64_t fill;
+	int i, c, n, victim;
+
+	n = 256 * font->glyph_h;
+
+	for (i = 0; i < (int)(sizeof(state.atlases) / sizeof(state.atlases[0])); i++)
+	{
+		if (state.atlases[i].font == font)
+		{
+			atlas = &state.atlases[i];
+			break;
+		}
+
+		if (atlas == NULL && state.atlases[i].font == NULL)
+			atlas = &state.atlases[i];
+	}
+
+	if (atlas == NULL)
+		return NULL;
+
+	/* expand the font once */
+	if (atlas->font != font)
+	{
+		atlas->masks = malloc(n * sizeof(uint64_t));
+		if (atlas->masks == NULL)
+			return NULL;
+		for (i = 0; i < n; i++)
+			atlas->masks[i] = glyph_row_mask(font->bitmap[i]);
+		atlas->font = font;
+	}
+
+	*masks = atlas->masks;
+
+	/* colors in use are ready, otherwise recolor the least recently used */
+	victim = 0;
+	for (c = 0; c < EUI_ATLAS_COLORS; c++)
+	{
+		if (atlas->colors[c].rows && atlas->colors[c].color == color)
+		{
+			atlas->colors[c].used = ++atlas->clock;
+			return atlas->colors[c].rows;
+		}
+
+		if (atlas->colors[c].used < atlas->colors[victim].used)
+			victim = c;
+	}
+
+	if (atlas->colors[victim].rows == NULL)
+	{
+		atlas->colors[victim].rows = malloc(n * sizeof(uint64_t));
+		if (atlas->colors[victim].rows == NULL)
+			return NULL;
+	}
+
+	fill = glyph_fill(color);
+	for (i = 0; i < n; i++)
+		atlas->colors[victim].rows[i] = atlas->masks[i] & fill;
+
+	atlas->colors[victim].color = color;
+	atlas->colors[victim].used = ++atlas->clock;
+
+	return atlas->colors[victim].rows;
+}
+
+/* draw a glyph into a 1, 2 or 4 bpp buffer a row of bytes at a time */
+static void set_glyph_packed(int x, int y, unsigned int glyph, unsigned int color, font_t *font, int bpp)
+{
+	const uint64_t *masks, *colored;
+	unsigned char *bitmap, *dst;
+	unsigned int cols, fill, row, b;
+	uint64_t mask, pixels;
+	int yy, y0, y1, skip, shift, i;
 
 	if (glyph >= 256)
 		return;
+	if (!glyph_clip(&x, y, font, &y0, &y1, &cols, &skip))
+		return;
 
 	bitmap = &font->bitmap[glyph * font->glyph_h];
+	dst = &((unsigned char *)state.buffer)[(y + y0) * state.pitch + ((x * bpp) >> 3)];
+	shift = (x * bpp) & 7;
 
-	for (yy = 0; yy < font->glyph_h; yy++)
+	/* whole glyphs come pre-colored from the atlas */
+	if (cols == 0xFF && (colored = atlas_rows(font, color, &masks)) != NULL)
 	{
-		for (xx = 0; xx < font->glyph_w; xx++)
+		masks += glyph * font->glyph_h;
+		colored += glyph * font->glyph_h;
+
+		for (yy = y0; yy < y1; yy++, dst += state.pitch)
 		{
-			if (bitmap[yy] & 1 << xx)
+			mask = masks[yy] >> shift;
+			pixels = colored[yy] >> shift;
+
+			for (i = 0; mask; i++, mask <<= 8, pixels <<= 8)
 			{
-				xxx = x + xx;
-				yyy = y + yy;
+				b = (unsigned int)(mask >> 56);
+				if (b)
+					dst[i] = (dst[i] & ~b) | (unsigned int)(pixels >> 56);
+			}
+		}
 
-				if (xxx < 0 || xxx >= state.w)
-					continue;
-				if (yyy < 0 || yyy >= state.h)
-					continue;
+		return;
+	}
 
-				state.set_pixel(xxx, yyy, color);
-			}
+	/* color repeated across a byte */
+	switch (bpp)
+	{
+		case 1: fill = (color & 0x1) * 0xFF; break;
+		case 2: fill = (color & 0x3) * 0x55; break;
+		default: fill = (color & 0xF) * 0x11; break;
+	}
+
+	for (yy = y0; yy < y1; yy++, dst += state.pitch)
+	{
+		row = (bitmap[yy] & cols) >> skip;
+		if (!row)
+			continue;
+
+		/* left aligned in 64 bits, then shifted to the first pixel's bit */
+		switch (bpp)
+		{
+			case 1: mask = (uint64_t)glyph_masks_1[row] << 56; break;
+			case 2: mask = (uint64_t)glyph_masks_2[row] << 48; break;
+			default: mask = (uint64_t)glyph_masks_4[row] << 32; break;
+		}
+		mask >>= shift;
+
+		for (i = 0; mask; i++, mask <<= 8)
+		{
+			b = (unsigned int)(mask >> 56);
+			if (b)
+				dst[i] = (dst[i] & ~b) | (fill & b);
+		}
+	}
+}
+
+static void set_glyph_1(int x, int y, unsigned int glyph, unsigned int color, font_t *font)
+{
+	set_glyph_packed(x, y, glyph, color, font, 1);
+}
+
+static void set_glyph_2(int x, int y, unsigned int glyph, unsigned int color, font_t *font)
+{
+	set_glyph_packed(x, y, glyph, color, font, 2);
+}
+
+static void set_glyph_4(int x, int y, unsigned int glyph, unsigned int color, font_t *font)
+{
+	set_glyph_packed(x, y, glyph, color, font, 4);
+}
+
+/* draw a glyph into an 8 bpp buffer, whole rows as one 8 byte masked write */
+static void set_glyph_8(int x, int y, unsigned int glyph, unsigned int color, font_t *font)
+{
+	const uint64_t *masks, *colored;
+	unsigned char *bitmap, *dst;
+	unsigned int cols, row;
+	uint64_t fill, mask, pixels;
+	int yy, y0, y1, skip, xx;
+
+	if (glyph >= 256)
+		return;
+	if (!glyph_clip(&x, y, font, &y0, &y1, &cols, &skip))
+		return;
+
+	bitmap = &font->bitmap[glyph * font->glyph_h];
+	dst = &((unsigned char *)state.buffer)[(y + y0) * state.pitch + x];
+
+	/* whole glyphs come pre-colored from the atlas, a masked copy per row */
+	if (cols == 0xFF && (colored = atlas_rows(font, color, &masks)) != NULL)
+	{
+		masks += glyph * font->glyph_h;
+		colored += glyph * font->glyph_h;
+
+		for (yy = y0; yy < y1; yy++, dst += state.pitch)
+		{
+			mask = masks[yy];
+			if (!mask)
+				continue;
+
+			memcpy(&pixels, dst, sizeof(pixels));
+			pixels = (pixels & ~mask) | colored[yy];
+			memcpy(dst, &pixels, sizeof(pixels));
+		}
+
+		return;
+	}
+
+	/* fully visible rows stay inside the buffer for all 8 bytes */
+	if (cols == 0xFF)
+	{
+		fill = (uint64_t)(color & 0xFF) * 0x0101010101010101ULL;
+
+		for (yy = y0; yy < y1; yy++, dst += state.pitch)
+		{
+			mask = glyph_masks_8[bitmap[yy]];
+			if (!mask)
+				continue;
+
+			memcpy(&pixels, dst, sizeof(pixels));
+			pixels = (pixels & ~mask) | (fill & mask);
+			memcpy(dst, &pixels, sizeof(pixels));
+		}
+
+		return;
+	}
+
+	/* glyphs cut by the screen edge */
+	for (yy = y0; yy < y1; yy++, dst += state.pitch)
+	{
+		for (xx = 0, row = (bitmap[yy] & cols) >> skip; row; xx++, row >>= 1)
+		{
+			if (row & 1)
+				dst[xx] = color;
 		}
 	}
 }
@@ -934,11 +1256,497 @@ static void eui_drawcmd_push(drawcmd_t *drawcmd)
 	memcpy(&state.drawcmds[state.num_drawcmds++], drawcmd, sizeof(drawcmd_t));
 }
 
-/* compare function for sorting drawcmds */
-static int eui_drawcmd_compare(const void *a, const void *b)
+/* push a line of text to the text arena and queue it as one drawcmd */
+static void eui_text_push(drawcmd_t *drawcmd, int x, int y, const char *s, int len)
+{
+	if (len <= 0 || state.text_len + len > EUI_MAX_TEXT)
+		return;
+
+	drawcmd->cmd.text.x = x;
+	drawcmd->cmd.text.y = y;
+	drawcmd->cmd.text.start = state.text_len;
+	drawcmd->cmd.text.len = len;
+
+	memcpy(&state.text[state.text_len], s, len);
+	state.text_len += len;
+
+	eui_drawcmd_push(drawcmd);
+}
+
+/* draw the visible glyphs of a text run */
+static void set_text_run(int x, int y, const char *s, int len, unsigned int color, font_t *font)
+{
+	int i;
+
+	/* entirely above or below the clip area */
+	if (y >= state.clip.y1 || y + font->glyph_h <= state.clip.y0)
+		return;
+
+	/* skip glyphs off the left edge */
+	i = 0;
+	if (x + font->glyph_w <= state.clip.x0)
+	{
+		i = (state.clip.x0 - x) / font->glyph_w;
+		x += i * font->glyph_w;
+	}
+
+	/* stop at the right edge */
+	for (; i < len && x < state.clip.x1; i++, x += font->glyph_w)
+		state.set_glyph(x, y, s[i], color, font);
+}
+
+/* z value as an unsigned key that sorts the same way */
+#define DRAWCMD_KEY(i) ((unsigned int)state.drawcmds[(i)].z ^ 0x80000000u)
+
+/* stable radix sort of keys packed in the upper 32 bits */
+/* diff has a bit set for every key bit that isn't the same in all of them */
+/* returns whichever of the two buffers ends up sorted */
+static uint64_t *eui_radix_sort(uint64_t *src, uint64_t *dst, int n, unsigned int diff)
+{
+	unsigned int counts[256];
+	unsigned int sum, c;
+	uint64_t *tmp;
+	int i, shift;
+
+	for (shift = 32; shift < 64; shift += 8)
+	{
+		if (!((diff >> (shift - 32)) & 0xFF))
+			continue;
+
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < n; i++)
+			counts[(src[i] >> shift) & 0xFF]++;
+
+		for (sum = 0, i = 0; i < 256; i++)
+		{
+			c = counts[i];
+			counts[i] = sum;
+			sum += c;
+		}
+
+		for (i = 0; i < n; i++)
+			dst[counts[(src[i] >> shift) & 0xFF]++] = src[i];
+
+		tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	return src;
+}
+
+/* sort drawcmd queue by z into drawcmds_order, keeping push order for ties */
+static void eui_drawcmd_sort(void)
+{
+	uint64_t *keys;
+	unsigned int first, diff, key, last = 0;
+	int i, j, n, runs, sorted;
+
+	n = state.num_drawcmds;
+
+	for (i = 0; i < n; i++)
+		state.drawcmds_order[i] = i;
+
+	if (n < 2)
+		return;
+
+	/* frames usually push in z order already */
+	sorted = EUI_TRUE;
+	for (i = 1; i < n; i++)
+	{
+		if (state.drawcmds[i].z < state.drawcmds[i - 1].z)
+		{
+			sorted = EUI_FALSE;
+			break;
+		}
+	}
+
+	if (sorted)
+		return;
+
+	/* a frame's drawcmds have consecutive z, so split the queue into runs */
+	/* of those and sort the runs by where they start */
+	first = DRAWCMD_KEY(0);
+	diff = 0;
+	runs = 0;
+	for (i = 0; i < n; i++)
+	{
+		key = DRAWCMD_KEY(i);
+		if (i == 0 || key != DRAWCMD_KEY(i - 1) + 1)
+		{
+			diff |= key ^ first;
+			state.drawcmds_keys[0][runs++] = ((uint64_t)key << 32) | (unsigned int)i;
+		}
+	}
+
+	keys = eui_radix_sort(state.drawcmds_keys[0], state.drawcmds_keys[1], runs, diff);
+
+	/* lay the runs out in order, fine as long as none of them overlap or tie */
+	for (n = 0, j = 0; j < runs; j++)
+	{
+		i = (int)(keys[j] & 0xFFFFFFFFu);
+		if (n && DRAWCMD_KEY(i) <= last)
+			break;
+
+		do {
+			state.drawcmds_order[n++] = i++;
+		} while (i < state.num_drawcmds && DRAWCMD_KEY(i) == DRAWCMD_KEY(i - 1) + 1);
+
+		last = DRAWCMD_KEY(i - 1);
+	}
+
+	if (j == runs)
+		return;
+
+	/* runs overlap, e.g. frames sharing a z, so sort every drawcmd */
+	n = state.num_drawcmds;
+	diff = 0;
+	for (i = 0; i < n; i++)
+	{
+		diff |= DRAWCMD_KEY(i) ^ first;
+		state.drawcmds_keys[0][i] = ((uint64_t)DRAWCMD_KEY(i) << 32) | (unsigned int)i;
+	}
+
+	keys = eui_radix_sort(state.drawcmds_keys[0], state.drawcmds_keys[1], n, diff);
+
+	for (i = 0; i < n; i++)
+		state.drawcmds_order[i] = (int)(keys[i] & 0xFFFFFFFFu);
+}
+
+/* fill the whole buffer with color */
+static void eui_screen_fill(unsigned int color)
+{
+	switch (state.bpp)
+	{
+		case 1:
+			if (color)
+				color = 0xFF;
+			else
+				color = 0x00;
+			break;
+
+		case 2:
+			color = color << 6 | color << 4 | color << 2 | color;
+			break;
+
+		case 4:
+			color = color << 4 | color;
+			break;
+	}
+
+	memset(state.buffer, color, state.h * state.pitch);
+}
+
+/* free change tracking tiles */
+static void tiles_free(void)
+{
+	free(state.tiles[0]);
+	free(state.tiles[1]);
+	free(state.dirty);
+	state.tiles[0] = NULL;
+	state.tiles[1] = NULL;
+	state.dirty = NULL;
+	state.tiles_valid = EUI_FALSE;
+}
+
+/* allocate change tracking tiles for the buffer size */
+/* without them every context end redraws the whole buffer */
+static void tiles_init(void)
+{
+	int n;
+
+	tiles_free();
+
+	state.tiles_w = (state.w + EUI_TILE_SIZE - 1) / EUI_TILE_SIZE;
+	state.tiles_h = (state.h + EUI_TILE_SIZE - 1) / EUI_TILE_SIZE;
+	n = state.tiles_w * state.tiles_h;
+
+	state.tiles[0] = malloc(n * sizeof(uint64_t));
+	state.tiles[1] = malloc(n * sizeof(uint64_t));
+	state.dirty = malloc(n * sizeof(eui_rect_t));
+	if (!state.tiles[0] || !state.tiles[1] || !state.dirty)
+		tiles_free();
+}
+
+/* fold an integer into a hash */
+static uint64_t hash_int(uint64_t hash, uint64_t v)
+{
+	hash ^= v;
+	hash *= 0x100000001B3ULL;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+/* fold bytes into a hash */
+static uint64_t hash_bytes(uint64_t hash, const void *data, int len)
+{
+	const unsigned char *p = data;
+	int i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash ^= p[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+/* work out where a drawcmd lands on screen */
+/* returns EUI_FALSE if it's entirely off screen */
+static int eui_drawcmd_bounds(drawcmd_t *drawcmd)
+{
+	int x, y, w, h;
+
+	switch (drawcmd->type)
+	{
+		case DRAW_PIXEL:
+			x = drawcmd->cmd.pixel.x;
+			y = drawcmd->cmd.pixel.y;
+			w = 1;
+			h = 1;
+			break;
+
+		case DRAW_BOX:
+			x = drawcmd->cmd.box.x;
+			y = drawcmd->cmd.box.y;
+			w = drawcmd->cmd.box.w;
+			h = drawcmd->cmd.box.h;
+			break;
+
+		case DRAW_TEXT_RUN:
+			x = drawcmd->cmd.text.x;
+			y = drawcmd->cmd.text.y;
+			w = drawcmd->cmd.text.len * drawcmd->cmd.text.font->glyph_w;
+			h = drawcmd->cmd.text.font->glyph_h;
+			break;
+
+		case DRAW_BITMAP:
+			x = drawcmd->cmd.bitmap.x;
+			y = drawcmd->cmd.bitmap.y;
+			w = drawcmd->cmd.bitmap.w;
+			h = drawcmd->cmd.bitmap.h;
+			break;
+
+		default:
+			x = y = w = h = 0;
+			break;
+	}
+
+	drawcmd->bounds.x0 = x < 0 ? 0 : x;
+	drawcmd->bounds.y0 = y < 0 ? 0 : y;
+	drawcmd->bounds.x1 = x + w > state.w ? state.w : x + w;
+	drawcmd->bounds.y1 = y + h > state.h ? state.h : y + h;
+
+	return drawcmd->bounds.x0 < drawcmd->bounds.x1 && drawcmd->bounds.y0 < drawcmd->bounds.y1;
+}
+
+/* hash what a drawcmd draws and where */
+static uint64_t eui_drawcmd_hash(drawcmd_t *drawcmd)
 {
-	/* compare z values */
-	return state.drawcmds[*(int *)a].z - state.drawcmds[*(int *)b].z;
+	uint64_t h;
+	int yy;
+
+	h = hash_int(0xCBF29CE484222325ULL, drawcmd->type);
+
+	switch (drawcmd->type)
+	{
+		case DRAW_PIXEL:
+			h = hash_int(h, (unsigned int)drawcmd->cmd.pixel.x);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.pixel.y);
+			h = hash_int(h, drawcmd->cmd.pixel.color);
+			break;
+
+		case DRAW_BOX:
+			h = hash_int(h, (unsigned int)drawcmd->cmd.box.x);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.box.y);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.box.w);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.box.h);
+			h = hash_int(h, drawcmd->cmd.box.color);
+			break;
+
+		case DRAW_TEXT_RUN:
+			h = hash_int(h, (unsigned int)drawcmd->cmd.text.x);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.text.y);
+			h = hash_int(h, drawcmd->cmd.text.color);
+			h = hash_int(h, (uintptr_t)drawcmd->cmd.text.font);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.text.len);
+			h = hash_bytes(h, &state.text[drawcmd->cmd.text.start], drawcmd->cmd.text.len);
+			break;
+
+		case DRAW_BITMAP:
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.x);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.y);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.w);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.h);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.bpp);
+			h = hash_int(h, (unsigned int)drawcmd->cmd.bitmap.pitch);
+
+			/* the caller says when the pixels change, so they needn't be read */
+			if (drawcmd->cmd.bitmap.versioned)
+			{
+				h = hash_int(h, (uintptr_t)drawcmd->cmd.bitmap.pixels);
+				h = hash_int(h, drawcmd->cmd.bitmap.generation);
+				break;
+			}
+
+			/* the pixels can change behind the same pointer */
+			for (yy = 0; yy < drawcmd->cmd.bitmap.h; yy++)
+			{
+				h = hash_bytes(h, (char *)drawcmd->cmd.bitmap.pixels + yy * drawcmd->cmd.bitmap.pitch,
+					(drawcmd->cmd.bitmap.w * drawcmd->cmd.bitmap.bpp + 7) >> 3);
+			}
+			break;
+	}
+
+	return h;
+}
+
+/* hash the sorted drawcmds into tiles and collect the ones that changed */
+/* as rectangles, returns EUI_FALSE if everything has to be redrawn */
+static int tiles_update(void)
+{
+	drawcmd_t *drawcmd;
+	eui_rect_t *rect;
+	uint64_t *tiles, *tmp, hash, seed;
+	int i, n, tx, ty, tx0, tx1, ty0, ty1, row, valid;
+
+	/* only screens cleared every time can be pieced together from tiles */
+	if (!state.tiles[0] || !state.clear)
+	{
+		state.tiles_valid = EUI_FALSE;
+		return EUI_FALSE;
+	}
+
+	/* every tile starts out as the clear color */
+	tiles = state.tiles[0];
+	n = state.tiles_w * state.tiles_h;
+	seed = hash_int(0xCBF29CE484222325ULL, state.clear_color);
+	for (i = 0; i < n; i++)
+		tiles[i] = seed;
+
+	/* then takes in everything drawn over it, in order */
+	for (i = 0; i < state.num_drawcmds; i++)
+	{
+		drawcmd = &state.drawcmds[state.drawcmds_order[i]];
+		if (!eui_drawcmd_bounds(drawcmd))
+			continue;
+
+		hash = eui_drawcmd_hash(drawcmd);
+
+		tx0 = drawcmd->bounds.x0 / EUI_TILE_SIZE;
+		ty0 = drawcmd->bounds.y0 / EUI_TILE_SIZE;
+		tx1 = (drawcmd->bounds.x1 - 1) / EUI_TILE_SIZE;
+		ty1 = (drawcmd->bounds.y1 - 1) / EUI_TILE_SIZE;
+
+		for (ty = ty0; ty <= ty1; ty++)
+			for (tx = tx0; tx <= tx1; tx++)
+				tiles[ty * state.tiles_w + tx] = hash_int(tiles[ty * state.tiles_w + tx], hash);
+	}
+
+	/* keep these hashes for next time */
+	valid = state.tiles_valid;
+	tmp = state.tiles[0];
+	state.tiles[0] = state.tiles[1];
+	state.tiles[1] = tmp;
+	state.tiles_valid = EUI_TRUE;
+
+	if (!valid)
+		return EUI_FALSE;
+
+	/* join changed tiles into spans, and spans into the same span a row up */
+	state.rects = state.dirty;
+	state.num_dirty = 0;
+	for (ty = 0; ty < state.tiles_h; ty++)
+	{
+		row = state.num_dirty;
+
+		for (tx = 0; tx < state.tiles_w; tx++)
+		{
+			if (tiles[ty * state.tiles_w + tx] == state.tiles[0][ty * state.tiles_w + tx])
+				continue;
+
+			for (tx0 = tx; tx < state.tiles_w; tx++)
+				if (tiles[ty * state.tiles_w + tx] == state.tiles[0][ty * state.tiles_w + tx])
+					break;
+
+			rect = NULL;
+			for (i = 0; i < row; i++)
+			{
+				if (state.dirty[i].x == tx0 * EUI_TILE_SIZE &&
+					state.dirty[i].w == (tx - tx0) * EUI_TILE_SIZE &&
+					state.dirty[i].y + state.dirty[i].h == ty * EUI_TILE_SIZE)
+				{
+					rect = &state.dirty[i];
+					break;
+				}
+			}
+
+			if (rect)
+			{
+				rect->h += EUI_TILE_SIZE;
+			}
+			else
+			{
+				rect = &state.dirty[state.num_dirty++];
+				rect->x = tx0 * EUI_TILE_SIZE;
+				rect->y = ty * EUI_TILE_SIZE;
+				rect->w = (tx - tx0) * EUI_TILE_SIZE;
+				rect->h = EUI_TILE_SIZE;
+			}
+		}
+	}
+
+	/* the last row and column of tiles can hang off the buffer */
+	for (i = 0; i < state.num_dirty; i++)
+	{
+		if (state.dirty[i].x + state.dirty[i].w > state.w)
+			state.dirty[i].w = state.w - state.dirty[i].x;
+		if (state.dirty[i].y + state.dirty[i].h > state.h)
+			state.dirty[i].h = state.h - state.dirty[i].y;
+	}
+
+	return EUI_TRUE;
+}
+
+/* rasterize a drawcmd, cut down to the clip area */
+static void eui_drawcmd_draw(drawcmd_t *drawcmd)
+{
+	int x0, y0, x1, y1;
+	char *pixels;
+
+	/* entirely outside the clip area */
+	x0 = drawcmd->bounds.x0 > state.clip.x0 ? drawcmd->bounds.x0 : state.clip.x0;
+	y0 = drawcmd->bounds.y0 > state.clip.y0 ? drawcmd->bounds.y0 : state.clip.y0;
+	x1 = drawcmd->bounds.x1 < state.clip.x1 ? drawcmd->bounds.x1 : state.clip.x1;
+	y1 = drawcmd->bounds.y1 < state.clip.y1 ? drawcmd->bounds.y1 : state.clip.y1;
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	switch (drawcmd->type)
+	{
+		case DRAW_PIXEL:
+			state.set_pixel(x0, y0, drawcmd->cmd.pixel.color);
+			break;
+
+		case DRAW_BOX:
+			state.set_box(x0, y0, x1 - x0, y1 - y0, drawcmd->cmd.box.color);
+			break;
+
+		case DRAW_TEXT_RUN:
+			set_text_run(drawcmd->cmd.text.x, drawcmd->cmd.text.y,
+				&state.text[drawcmd->cmd.text.start], drawcmd->cmd.text.len,
+				drawcmd->cmd.text.color, drawcmd->cmd.text.font);
+			break;
+
+		case DRAW_BITMAP:
+			pixels = (char *)drawcmd->cmd.bitmap.pixels;
+			pixels += (y0 - drawcmd->cmd.bitmap.y) * drawcmd->cmd.bitmap.pitch;
+			pixels += ((x0 - drawcmd->cmd.bitmap.x) * drawcmd->cmd.bitmap.bpp) >> 3;
+			state.set_bitmap(x0, y0, x1 - x0, y1 - y0,
+				drawcmd->cmd.bitmap.bpp, drawcmd->cmd.bitmap.pitch, pixels);
+			break;
+	}
 }
 
 /*
@@ -964,24 +1772,28 @@ int eui_init(int w, int h, int bpp, int pitch, void *buffer)
 		case 1:
 			state.set_pixel = set_pixel_1;
 			state.set_box = set_box_1;
+			state.set_glyph = set_glyph_1;
 			state.set_bitmap = set_bitmap_1;
 			break;
 
 		case 2:
 			state.set_pixel = set_pixel_2;
 			state.set_box = set_box_2;
+			state.set_glyph = set_glyph_2;
 			state.set_bitmap = set_bitmap_2;
 			break;
 
 		case 4:
 			state.set_pixel = set_pixel_4;
 			state.set_box = set_box_4;
+			state.set_glyph = set_glyph_4;
 			state.set_bitmap = set_bitmap_4;
 			break;
 
 		case 8:
 			state.set_pixel = set_pixel_8;
 			state.set_box = set_box_8;
+			state.set_glyph = set_glyph_8;
 			state.set_bitmap = set_bitmap_8;
 			break;
 
@@ -996,7 +1808,21 @@ int eui_init(int w, int h, int bpp, int pitch, void *buffer)
 	state.pitch = pitch;
 	state.buffer = buffer;
 	eui_font_set(EUI_FONT_8X8);
-	state.set_glyph = set_glyph_font_bitmap;
+	glyph_masks_init();
+	atlas_free_all();
+
+	/* rasterize to the whole buffer, tracking changes in tiles */
+	state.clip.x0 = 0;
+	state.clip.y0 = 0;
+	state.clip.x1 = w;
+	state.clip.y1 = h;
+	state.screen.x = 0;
+	state.screen.y = 0;
+	state.screen.w = w;
+	state.screen.h = h;
+	state.rects = &state.screen;
+	state.num_dirty = 0;
+	tiles_init();
 
 	return EUI_TRUE;
 }
@@ -1004,6 +1830,8 @@ int eui_init(int w, int h, int bpp, int pitch, void *buffer)
 /* shutdown library and clear state */
 void eui_quit(void)
 {
+	atlas_free_all();
+	tiles_free();
 	memset(&state, 0, sizeof(state));
 }
 
@@ -1017,7 +1845,10 @@ int eui_context_begin(void)
 {
 	state.frame_index = 0;
 	state.num_drawcmds = 0;
+	state.text_len = 0;
 	state.frame_z = 0;
+	state.drawing = EUI_TRUE;
+	state.clear = EUI_FALSE;
 	if (!eui_frame_push(0, 0, state.w, state.h))
 		return EUI_FALSE;
 
@@ -1027,44 +1858,65 @@ int eui_context_begin(void)
 /* end current eui context and destroy root frame */
 void eui_context_end(void)
 {
-	drawcmd_t *drawcmd;
-	int i;
+	eui_rect_t *rect;
+	int i, r;
 
-	/* init sorted queue */
-	for (i = 0; i < state.num_drawcmds; i++)
-		state.drawcmds_order[i] = i;
+	state.drawing = EUI_FALSE;
 
 	/* sort drawcmd queue */
-	qsort(state.drawcmds_order, state.num_drawcmds, sizeof(int), eui_drawcmd_compare);
+	eui_drawcmd_sort();
 
-	/* go through drawcmd queue */
-	for (i = 0; i < state.num_drawcmds; i++)
+	/* find what changed, or redraw everything */
+	if (!tiles_update())
 	{
-		drawcmd = &state.drawcmds[state.drawcmds_order[i]];
-		switch (drawcmd->type)
-		{
-			case DRAW_PIXEL:
-				state.set_pixel(drawcmd->cmd.pixel.x, drawcmd->cmd.pixel.y, drawcmd->cmd.pixel.color);
-				break;
+		for (i = 0; i < state.num_drawcmds; i++)
+			eui_drawcmd_bounds(&state.drawcmds[i]);
 
-			case DRAW_BOX:
-				state.set_box(drawcmd->cmd.box.x, drawcmd->cmd.box.y, drawcmd->cmd.box.w, drawcmd->cmd.box.h, drawcmd->cmd.box.color);
-				break;
+		if (state.clear)
+			eui_screen_fill(state.clear_color);
 
-			case DRAW_GLYPH:
-				state.set_glyph(drawcmd->cmd.glyph.x, drawcmd->cmd.glyph.y,
-					drawcmd->cmd.glyph.glyph, drawcmd->cmd.glyph.color,
-					drawcmd->cmd.glyph.font);
-				break;
+		state.rects = &state.screen;
+		state.num_dirty = 1;
+	}
+	else if (state.clear)
+	{
+		for (r = 0; r < state.num_dirty; r++)
+			state.set_box(state.dirty[r].x, state.dirty[r].y, state.dirty[r].w, state.dirty[r].h, state.clear_color);
+	}
 
-			case DRAW_BITMAP:
-				state.set_bitmap(drawcmd->cmd.bitmap.x, drawcmd->cmd.bitmap.y,
-					drawcmd->cmd.bitmap.w, drawcmd->cmd.bitmap.h,
-					drawcmd->cmd.bitmap.bpp, drawcmd->cmd.bitmap.pitch,
-					drawcmd->cmd.bitmap.pixels);
-				break;
-		}
+	/* go through drawcmd queue once per changed rectangle */
+	for (r = 0; r < state.num_dirty; r++)
+	{
+		rect = &state.rects[r];
+		state.clip.x0 = rect->x;
+		state.clip.y0 = rect->y;
+		state.clip.x1 = rect->x + rect->w;
+		state.clip.y1 = rect->y + rect->h;
+
+		for (i = 0; i < state.num_drawcmds; i++)
+			eui_drawcmd_draw(&state.drawcmds[state.drawcmds_order[i]]);
 	}
+
+	state.clip.x0 = 0;
+	state.clip.y0 = 0;
+	state.clip.x1 = state.w;
+	state.clip.y1 = state.h;
+}
+
+/* get the rectangles of the buffer the last context end wrote to */
+/* returns the number of rectangles */
+int eui_context_dirty_get(const eui_rect_t **rects)
+{
+	if (rects)
+		*rects = state.rects;
+
+	return state.num_dirty;
+}
+
+/* redraw everything at the next context end, e.g. after the buffer was written to */
+void eui_context_invalidate(void)
+{
+	state.tiles_valid = EUI_FALSE;
 }
 
 /*
@@ -1183,28 +2035,19 @@ int eui_font_get(void)
  * utilities
  */
 
-/* clear screen with color */
+/* clear screen with color, deferred to the context end inside a context */
 void eui_screen_clear(unsigned int color)
 {
-	switch (state.bpp)
+	if (state.drawing)
 	{
-		case 1:
-			if (color)
-				color = 0xFF;
-			else
-				color = 0x00;
-			break;
-
-		case 2:
-			color = color << 6 | color << 4 | color << 2 | color;
-			break;
-
-		case 4:
-			color = color << 4 | color;
-			break;
+		state.clear = EUI_TRUE;
+		state.clear_color = color;
+		return;
 	}
 
-	memset(state.buffer, color, state.h * state.pitch);
+	/* anything drawn before is gone */
+	state.tiles_valid = EUI_FALSE;
+	eui_screen_fill(color);
 }
 
 /* get cell dimensions of text, with newline and alignment handling */
@@ -1385,7 +2228,7 @@ void eui_draw_text(int x, int y, unsigned int color, char *s)
 {
 	int c;
 	int start_x;
-	char *ptr;
+	char *ptr, *run;
 	int w, h;
 	unsigned int len = 0;
 	drawcmd_t drawcmd;
@@ -1398,16 +2241,20 @@ void eui_draw_text(int x, int y, unsigned int color, char *s)
 	eui_transform_box(&x, &y, w, h);
 
 	/* setup drawcmd */
-	drawcmd.type = DRAW_GLYPH;
-	drawcmd.cmd.glyph.color = color;
-	drawcmd.cmd.glyph.font = state.font;
+	drawcmd.type = DRAW_TEXT_RUN;
+	drawcmd.cmd.text.color = color;
+	drawcmd.cmd.text.font = state.font;
 
-	/* draw string */
+	/* draw string a line at a time */
 	start_x = x;
+	run = s;
 	while ((c = *s++))
 	{
 		if (c == '\n')
 		{
+			eui_text_push(&drawcmd, x, y, run, s - 1 - run);
+			run = s;
+
 			switch (state.frames[state.frame_index].align.x)
 			{
 				case EUI_ALIGN_START:
@@ -1437,15 +2284,9 @@ void eui_draw_text(int x, int y, unsigned int color, char *s)
 					break;
 			}
 		}
-		else
-		{
-			drawcmd.cmd.glyph.x = x;
-			drawcmd.cmd.glyph.y = y;
-			drawcmd.cmd.glyph.glyph = c;
-			eui_drawcmd_push(&drawcmd);
-			x += state.font->glyph_w;
-		}
 	}
+
+	eui_text_push(&drawcmd, x, y, run, s - 1 - run);
 }
 
 /* draw formatted text */
@@ -1462,8 +2303,8 @@ void eui_draw_textf(int x, int y, unsigned int color, char *s, ...)
 }
 
 
-/* draw bitmap */
-void eui_draw_bitmap(int x, int y, int w, int h, int bpp, int pitch, void *pixels)
+/* push bitmap drawcmd, versioned ones are hashed by generation instead of pixels */
+static void eui_draw_bitmap_push(int x, int y, int w, int h, int bpp, int pitch, void *pixels, int versioned, unsigned int generation)
 {
 	drawcmd_t drawcmd;
 
@@ -1484,5 +2325,19 @@ void eui_draw_bitmap(int x, int y, int w, int h, int bpp, int pitch, void *pixel
 	drawcmd.cmd.bitmap.bpp = bpp;
 	drawcmd.cmd.bitmap.pitch = pitch;
 	drawcmd.cmd.bitmap.pixels = pixels;
+	drawcmd.cmd.bitmap.versioned = versioned;
+	drawcmd.cmd.bitmap.generation = generation;
 	eui_drawcmd_push(&drawcmd);
 }
+
+/* draw bitmap */
+void eui_draw_bitmap(int x, int y, int w, int h, int bpp, int pitch, void *pixels)
+{
+	eui_draw_bitmap_push(x, y, w, h, bpp, pitch, pixels, EUI_FALSE, 0);
+}
+
+/* draw bitmap whose pixels only change along with generation */
+void eui_draw_bitmap_generation(int x, int y, int w, int h, int bpp, int pitch, void *pixels, unsigned int generation)
+{
+	eui_draw_bitmap_push(x, y, w, h, bpp, pitch, pixels, EUI_TRUE, generation);
+}
@@ -43,6 +43,21 @@ extern "C" {
 #define EUI_MAX_DRAWCMDS (8192)
 #endif
 
+/* bytes of text that can be drawn in one context */
+#ifndef EUI_MAX_TEXT
+#define EUI_MAX_TEXT (65536)
+#endif
+
+/* colors kept pre-rendered per font, least recently used goes first */
+#ifndef EUI_ATLAS_COLORS
+#define EUI_ATLAS_COLORS (8)
+#endif
+
+/* size of the square tiles changes are tracked in, a multiple of 8 */
+#ifndef EUI_TILE_SIZE
+#define EUI_TILE_SIZE (32)
+#endif
+
 #define EUI_UNUSED(x) ((void)(x))
 
 /*
@@ -70,6 +85,18 @@ enum {
 	EUI_FONT_8X14
 };
 
+/*
+ *
+ * types
+ *
+ */
+
+/* rectangle of buffer pixels */
+typedef struct eui_rect_t {
+	int x, y;
+	int w, h;
+} eui_rect_t;
+
 /*
  *
  * function prototypes
@@ -96,8 +123,16 @@ void eui_quit(void);
 int eui_context_begin(void);
 
 /* end current eui context and destroy root frame */
+/* if the context cleared the screen, only tiles that changed since the last one are redrawn */
 void eui_context_end(void);
 
+/* get the rectangles of the buffer the last context end wrote to */
+/* returns the number of rectangles */
+int eui_context_dirty_get(const eui_rect_t **rects);
+
+/* redraw everything at the next context end, e.g. after the buffer was written to */
+void eui_context_invalidate(void);
+
 /*
  * frame handling
  */
@@ -144,7 +179,7 @@ int eui_font_get(void);
  * utilities
  */
 
-/* clear screen with color */
+/* clear screen with color, deferred to the context end inside a context */
 void eui_screen_clear(unsigned int color);
 
 /* get cell dimensions of text, with newline and alignment handling */
@@ -180,6 +215,10 @@ void eui_draw_textf(int x, int y, unsigned int color, char *s, ...);
 /* draw bitmap */
 void eui_draw_bitmap(int x, int y, int w, int h, int bpp, int pitch, void *pixels);
 
+/* draw bitmap whose pixels only change along with generation */
+/* partial redraw then skips hashing the pixels, bump generation after writing to them */
+void eui_draw_bitmap_generation(int x, int y, int w, int h, int bpp, int pitch, void *pixels, unsigned int generation);
+
 #ifdef __cplusplus
 }
 #endif
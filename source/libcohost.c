@@ -40,24 +40,74 @@ SOFTWARE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <curl/curl.h>
 
 #include "thirdparty/cJSON.h"
 
 #include "libcohost.h"
+#include "libcohost_cache.h"
+#include "libcohost_json.h"
+#include "libcohost_arena.h"
+#include "libcohost_post.h"
+#include "libcohost_intern.h"
+#include "libcohost_limit.h"
+#include "libcohost_transport.h"
 
 #define ASIZE(a) (sizeof(a)/sizeof(a[0]))
 #define UNUSED(x) ((void)(x))
+#define STATUS_OK(s) ((s) >= 200 && (s) < 300)
 
 /* these must always end with a forward slash */
 #define COHOST_API_BASE "https://cohost.org/api/v1/"
 #define COHOST_API_LOGIN COHOST_API_BASE "login/"
+#define COHOST_API_PROJECT COHOST_API_BASE "project/"
 
-/* curl response catcher */
-typedef struct curl_response_t {
-	char *string;
-	size_t len_string;
-} curl_response_t;
+/* smallest backing store handed out for a response buffer */
+#define BUFFER_MIN_SIZE (4096)
+
+/* worker message ring, must be a power of two and comfortably hold */
+/* a submit, cancel and release message for every request in flight */
+#define RING_SIZE (LIBCOHOST_MAX_REQUESTS * 8)
+
+/* how long the worker sleeps when nothing is happening */
+#define WORKER_POLL_TIMEOUT (1000)
+
+/* worker message types */
+enum {
+	MESSAGE_SUBMIT,
+	MESSAGE_CANCEL,
+	MESSAGE_RELEASE,
+	MESSAGE_DONE
+};
+
+/* message passed between the caller and the worker thread */
+typedef struct message_t {
+	int type;
+	libcohost_request_t *request;
+} message_t;
+
+/* single producer, single consumer lock-free ring */
+/* head and tail live on their own cache lines to avoid false sharing */
+typedef struct ring_t {
+	atomic_size_t head;
+	char pad_head[64 - sizeof(atomic_size_t)];
+	atomic_size_t tail;
+	char pad_tail[64 - sizeof(atomic_size_t)];
+	message_t messages[RING_SIZE];
+} ring_t;
+
+/* background network thread */
+typedef struct worker_t {
+	pthread_t thread;
+	atomic_int running;
+	ring_t inbox;
+	ring_t outbox;
+} worker_t;
 
 /* startup library */
 int libcohost_init(void)
@@ -65,12 +115,16 @@ int libcohost_init(void)
 	if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0)
 		return LIBCOHOST_RESULT_CURL_INIT_FAIL;
 
+	libcohost_arena_hooks_install();
+	libcohost_json_scan_set(LIBCOHOST_JSON_SCAN_AVX2);
+
 	return LIBCOHOST_RESULT_OK;
 }
 
 /* shutdown library */
 void libcohost_quit(void)
 {
+	libcohost_intern_free();
 	curl_global_cleanup();
 }
 
@@ -84,7 +138,8 @@ const char *libcohost_result_string(int r)
 		"Couldn't connect to cohost.org",
 		"Bad login credentials",
 		"Failed to initialize libcurl",
-		"General libcurl failure"
+		"General libcurl failure",
+		"Request cancelled"
 	};
 
 	if (r < 0 || r >= (int)ASIZE(results))
@@ -93,79 +148,1589 @@ const char *libcohost_result_string(int r)
 	return results[r];
 }
 
-/* free curl response */
-static void curl_response_free(curl_response_t *response)
+/* 64-bit fnv-1a hash, chain calls by passing the previous result as seed */
+uint64_t libcohost_hash(const void *data, size_t len, uint64_t seed)
 {
-	if (response->string)
-		free(response->string);
+	const unsigned char *bytes = data;
+	uint64_t hash = seed;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
 
-	response->len_string = 0;
+	return hash;
 }
 
-/* catch curl response */
-static size_t curl_response_catch(void *pointer, size_t size, size_t nmemb, curl_response_t *response)
+/* make sure buffer can hold at least size bytes plus a nul terminator */
+int libcohost_buffer_reserve(libcohost_buffer_t *buffer, size_t size)
 {
-	size_t new_length = size * nmemb;
+	size_t new_size;
+	char *new_data;
+
+	if (size < buffer->size)
+		return LIBCOHOST_RESULT_OK;
+
+	/* grow geometrically so appends are amortized constant time */
+	new_size = buffer->size ? buffer->size : BUFFER_MIN_SIZE;
+	while (new_size <= size)
+		new_size *= 2;
 
-	/* setup response string */
-	response->string = malloc(new_length + 1);
-	response->string[new_length] = '\0';
-	response->len_string = new_length;
+	new_data = realloc(buffer->data, new_size);
+	if (new_data == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
 
-	/* copy in response */
-	memcpy(response->string, pointer, new_length);
+	buffer->data = new_data;
+	buffer->size = new_size;
+	buffer->data[buffer->len] = '\0';
 
-	return new_length;
+	return LIBCOHOST_RESULT_OK;
 }
 
-/* create a new cohost session */
-int libcohost_session_new(libcohost_session_t *session, char *email, char *password, char *cookie_save_filename)
+/* append bytes to buffer, growing it geometrically */
+int libcohost_buffer_append(libcohost_buffer_t *buffer, const void *data, size_t len)
 {
-	static char url[512];
-	static char post[1024];
-	curl_response_t resp_body = {0};
-	curl_response_t resp_head = {0};
-	cJSON *json = NULL;
-	cJSON *json_item = NULL;
+	if (libcohost_buffer_reserve(buffer, buffer->len + len) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
 
-	UNUSED(cookie_save_filename);
+	memcpy(buffer->data + buffer->len, data, len);
+	buffer->len += len;
+	buffer->data[buffer->len] = '\0';
 
-	if (email == NULL || password == NULL)
-		return LIBCOHOST_RESULT_BAD_CREDENTIALS;
+	return LIBCOHOST_RESULT_OK;
+}
 
-	/* setup curl */
-	session->curl = curl_easy_init();
-	if (session->curl == NULL)
+/* empty buffer but keep its backing store for reuse */
+void libcohost_buffer_reset(libcohost_buffer_t *buffer)
+{
+	buffer->len = 0;
+	if (buffer->data)
+		buffer->data[0] = '\0';
+}
+
+/* release buffer backing store */
+void libcohost_buffer_free(libcohost_buffer_t *buffer)
+{
+	if (buffer->data)
+		free(buffer->data);
+
+	buffer->data = NULL;
+	buffer->len = 0;
+	buffer->size = 0;
+}
+
+/* case insensitive check for a header name at the start of a header line */
+static int header_match(const char *line, size_t len, const char *name)
+{
+	size_t i;
+
+	for (i = 0; name[i]; i++)
+	{
+		if (i >= len)
+			return 0;
+		if (tolower((unsigned char)line[i]) != tolower((unsigned char)name[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+/* copy the trimmed value of a response header into out */
+/* returns 0 if the header is not present */
+static int header_find(libcohost_buffer_t *head, const char *name, char *out, size_t len)
+{
+	size_t name_len = strlen(name);
+	char *line, *end;
+	size_t i;
+
+	if (head->data == NULL)
+		return 0;
+
+	for (line = head->data; *line; line = end)
+	{
+		end = strchr(line, '\n');
+		end = end ? end + 1 : line + strlen(line);
+
+		if (!header_match(line, end - line, name))
+			continue;
+
+		/* skip leading whitespace, drop trailing whitespace and crlf */
+		line += name_len;
+		while (line < end && (*line == ' ' || *line == '\t'))
+			line++;
+		while (end > line && isspace((unsigned char)end[-1]))
+			end--;
+
+		for (i = 0; line < end && i < len - 1; i++)
+			out[i] = *line++;
+		out[i] = '\0';
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/* check if final responses are being saved */
+static int transport_recording(void)
+{
+	libcohost_transport_t *transport = libcohost_transport_current();
+
+	return transport && transport->mode == LIBCOHOST_TRANSPORT_RECORD;
+}
+
+/* check if transfers are answered from recordings */
+static int transport_replaying(void)
+{
+	libcohost_transport_t *transport = libcohost_transport_current();
+
+	return transport && transport->mode == LIBCOHOST_TRANSPORT_REPLAY;
+}
+
+/* catch curl response body */
+static size_t curl_body_catch(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	libcohost_handle_t *handle = userdata;
+	size_t len = size * nmemb;
+	libcohost_arena_t *arena;
+	int result;
+
+	/* streamed requests are parsed as they arrive instead of buffered, */
+	/* error bodies are kept like any other so they never reach the parser */
+	if (handle->request && handle->request->stream && STATUS_OK(handle->status))
+	{
+		arena = libcohost_arena_use(handle->request->arena);
+		result = libcohost_json_stream_feed(handle->request->stream, ptr, len);
+		libcohost_arena_use(arena);
+		if (result != LIBCOHOST_RESULT_OK)
+			return 0;
+
+		/* recordings need the bytes too, so keep a copy while recording */
+		handle->streamed = 1;
+		if (transport_recording() && libcohost_buffer_append(&handle->body, ptr, len) != LIBCOHOST_RESULT_OK)
+			return 0;
+
+		return len;
+	}
+
+	/* returning a short count makes curl abort the transfer */
+	if (libcohost_buffer_append(&handle->body, ptr, len) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	return len;
+}
+
+/* catch curl response headers, one line per call */
+static size_t curl_head_catch(char *ptr, size_t size, size_t nmemb, void *userdata)
+{
+	static const char content_length[] = "Content-Length:";
+	libcohost_handle_t *handle = userdata;
+	size_t len = size * nmemb;
+	char *line = ptr, *status;
+	unsigned long body_len;
+
+	/* a new status line means a new response, e.g. after a redirect */
+	if (header_match(line, len, "HTTP/"))
+		libcohost_buffer_reset(&handle->head);
+
+	if (libcohost_buffer_append(&handle->head, ptr, len) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	/* the body callback needs the status before curl reports it */
+	if (header_match(line, len, "HTTP/") && (status = memchr(handle->head.data, ' ', handle->head.len)))
+		handle->status = strtol(status + 1, NULL, 10);
+
+	/* pre-size the body so it arrives in a single allocation */
+	if (header_match(line, len, content_length))
+	{
+		body_len = strtoul(handle->head.data + handle->head.len - len + sizeof(content_length) - 1, NULL, 10);
+		if (body_len && libcohost_buffer_reserve(&handle->body, body_len) != LIBCOHOST_RESULT_OK)
+			return 0;
+	}
+
+	return len;
+}
+
+/* create the share object that lets pooled handles reuse connections */
+static int share_init(libcohost_session_t *session)
+{
+	session->share = curl_share_init();
+	if (session->share == NULL)
 		return LIBCOHOST_RESULT_CURL_INIT_FAIL;
 
-	/* setup url for GET request */
-	snprintf(url, sizeof(url), COHOST_API_LOGIN "salt?email=%s", email);
+	curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+	curl_share_setopt(session->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
 
-	/* set CURLOPTs and send GET request */
-	curl_easy_setopt(session->curl, CURLOPT_URL, url);
-	curl_easy_setopt(session->curl, CURLOPT_FOLLOWLOCATION, 1);
-	curl_easy_setopt(session->curl, CURLOPT_COOKIEFILE, "");
-	curl_easy_setopt(session->curl, CURLOPT_WRITEFUNCTION, curl_response_catch);
-	curl_easy_setopt(session->curl, CURLOPT_WRITEDATA, &resp_body);
-	curl_easy_setopt(session->curl, CURLOPT_HEADERFUNCTION, curl_response_catch);
-	curl_easy_setopt(session->curl, CURLOPT_HEADERDATA, &resp_head);
-	if (curl_easy_perform(session->curl) != CURLE_OK)
-		return LIBCOHOST_RESULT_CURL_FAIL;
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* create curl handle with the options every request shares */
+static int handle_init(libcohost_session_t *session, libcohost_handle_t *handle)
+{
+	handle->curl = curl_easy_init();
+	if (handle->curl == NULL)
+		return LIBCOHOST_RESULT_CURL_INIT_FAIL;
 
-	/* free response structs */
-	curl_response_free(&resp_head);
-	curl_response_free(&resp_body);
+	curl_easy_setopt(handle->curl, CURLOPT_SHARE, session->share);
+	curl_easy_setopt(handle->curl, CURLOPT_FOLLOWLOCATION, 1L);
+	curl_easy_setopt(handle->curl, CURLOPT_COOKIEFILE, "");
+	curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(handle->curl, CURLOPT_WRITEFUNCTION, curl_body_catch);
+	curl_easy_setopt(handle->curl, CURLOPT_WRITEDATA, handle);
+	curl_easy_setopt(handle->curl, CURLOPT_HEADERFUNCTION, curl_head_catch);
+	curl_easy_setopt(handle->curl, CURLOPT_HEADERDATA, handle);
+	curl_easy_setopt(handle->curl, CURLOPT_PRIVATE, handle);
 
 	return LIBCOHOST_RESULT_OK;
 }
 
-/* destroy an active session */
-void libcohost_session_destroy(libcohost_session_t *session)
+/* reset handle for a new GET request */
+static void handle_prepare(libcohost_session_t *session, libcohost_handle_t *handle, const char *url)
 {
-	if (session)
+	char rewritten[1024];
+
+	/* the transport may point us at a stand-in server */
+	if (libcohost_transport_rewrite(libcohost_transport_current(), url, rewritten, sizeof(rewritten)))
+		url = rewritten;
+
+	libcohost_buffer_reset(&handle->head);
+	libcohost_buffer_reset(&handle->body);
+	handle->status = 0;
+	handle->streamed = 0;
+
+	/* drop request headers of the previous transfer */
+	curl_easy_setopt(handle->curl, CURLOPT_HTTPHEADER, NULL);
+	curl_slist_free_all(handle->headers);
+	handle->headers = NULL;
+
+	curl_easy_setopt(handle->curl, CURLOPT_URL, url);
+	curl_easy_setopt(handle->curl, CURLOPT_HTTPGET, 1L);
+
+	/* an empty string offers every encoding curl was built with, */
+	/* which it then decodes chunk by chunk into the body buffer */
+	curl_easy_setopt(handle->curl, CURLOPT_ACCEPT_ENCODING, session->compression_disabled ? NULL : "");
+
+	/* wait for a multiplexed connection instead of opening a second one */
+	if (session->http_version == LIBCOHOST_HTTP_1_1)
+	{
+		curl_easy_setopt(handle->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_1_1);
+		curl_easy_setopt(handle->curl, CURLOPT_PIPEWAIT, 0L);
+	}
+	else
+	{
+		curl_easy_setopt(handle->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+		curl_easy_setopt(handle->curl, CURLOPT_PIPEWAIT, 1L);
+	}
+}
+
+/* update session counters after a finished transfer */
+static void handle_account(libcohost_session_t *session, libcohost_handle_t *handle)
+{
+	long num_connects = 0;
+	long http_version = 0;
+	curl_off_t time_total = 0;
+	curl_off_t bytes_wire = 0;
+
+	curl_easy_getinfo(handle->curl, CURLINFO_RESPONSE_CODE, &handle->status);
+	curl_easy_getinfo(handle->curl, CURLINFO_NUM_CONNECTS, &num_connects);
+	curl_easy_getinfo(handle->curl, CURLINFO_HTTP_VERSION, &http_version);
+	curl_easy_getinfo(handle->curl, CURLINFO_TOTAL_TIME_T, &time_total);
+	curl_easy_getinfo(handle->curl, CURLINFO_SIZE_DOWNLOAD_T, &bytes_wire);
+
+	handle->time_total = (unsigned long)time_total;
+
+	/* curl counts body bytes before content decoding */
+	handle->bytes_wire = (unsigned long)bytes_wire;
+	session->stats.bytes_wire += handle->bytes_wire;
+	session->stats.bytes_decoded += handle->body.len;
+
+	/* no new connects means an existing keep-alive connection was used */
+	session->stats.requests++;
+	if (num_connects)
+		session->stats.conn_new += num_connects;
+	else
+		session->stats.conn_reused++;
+
+	if (http_version == CURL_HTTP_VERSION_2_0)
+		session->stats.http2++;
+}
+
+/* answer a transfer from the transport's recordings, without a socket */
+static CURLcode handle_replay(libcohost_session_t *session, libcohost_handle_t *handle, const char *url)
+{
+	if (libcohost_transport_load(libcohost_transport_current(), url, &handle->status, &handle->head, &handle->body) != LIBCOHOST_RESULT_OK)
+		return CURLE_COULDNT_CONNECT;
+
+	handle->time_total = 0;
+	handle->bytes_wire = handle->body.len;
+	session->stats.requests++;
+	session->stats.bytes_wire += handle->bytes_wire;
+	session->stats.bytes_decoded += handle->body.len;
+
+	return CURLE_OK;
+}
+
+/* save a final response if the transport is recording */
+static void transport_record(const char *url, libcohost_handle_t *handle)
+{
+	if (transport_recording() && handle->status != 304)
+		libcohost_transport_save(libcohost_transport_current(), url, handle->status, &handle->head, &handle->body);
+}
+
+/* take an idle handle from the session pool, warming up a new one if needed */
+libcohost_handle_t *libcohost_handle_acquire(libcohost_session_t *session)
+{
+	libcohost_handle_t *handle;
+	int i;
+
+	for (i = 0; i < session->num_handles; i++)
+	{
+		if (!session->handles[i].busy)
+		{
+			session->handles[i].busy = 1;
+			return &session->handles[i];
+		}
+	}
+
+	if (session->num_handles == LIBCOHOST_MAX_HANDLES)
+		return NULL;
+
+	handle = &session->handles[session->num_handles];
+	if (handle_init(session, handle) != LIBCOHOST_RESULT_OK)
+		return NULL;
+
+	session->num_handles++;
+	handle->busy = 1;
+
+	return handle;
+}
+
+/* return a handle to the session pool, keeping its connection and buffers */
+void libcohost_handle_release(libcohost_handle_t *handle)
+{
+	if (handle)
+	{
+		handle->busy = 0;
+		handle->request = NULL;
+	}
+}
+
+/*
+ * async requests
+ */
+
+/* append request to a singly linked fifo */
+static void request_list_push(libcohost_request_t **head, libcohost_request_t **tail, libcohost_request_t *request)
+{
+	request->next = NULL;
+
+	if (*tail)
+		(*tail)->next = request;
+	else
+		*head = request;
+
+	*tail = request;
+}
+
+/* give a coalesced request the results of its leader */
+static int request_share(libcohost_request_t *request, libcohost_request_t *leader)
+{
+	request->status = leader->status;
+	request->time_total = leader->time_total;
+	request->bytes_wire = leader->bytes_wire;
+	request->cached = leader->cached;
+	request->head = leader->head;
+	request->body = leader->body;
+
+	/* trees and indices are only read, the leader frees them after us */
+	request->json = leader->json;
+	if (request->index)
+	{
+		libcohost_json_index_free(request->index);
+		free(request->index);
+	}
+	request->index = leader->index;
+
+	/* callers take pages away, so every request gets its own */
+	if (request->page && leader->page)
+		return libcohost_page_copy(request->page, leader->page);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* move request to the done list, it is handed back to the caller on the next dispatch */
+static void request_finish(libcohost_session_t *session, libcohost_request_t *request, int result)
+{
+	libcohost_request_t *follower;
+
+	/* coalesced requests go first, so the leader still holds what they share */
+	while ((follower = request->coalesced))
+	{
+		request->coalesced = follower->coalesced_next;
+		follower->coalesced_next = NULL;
+		follower->state = LIBCOHOST_REQUEST_DONE;
+		follower->result = result;
+		if (result == LIBCOHOST_RESULT_OK && request_share(follower, request) != LIBCOHOST_RESULT_OK)
+			follower->result = LIBCOHOST_RESULT_ALLOC_FAIL;
+		request_list_push(&session->done, &session->done_tail, follower);
+	}
+
+	request->state = LIBCOHOST_REQUEST_DONE;
+	request->result = result;
+	request_list_push(&session->done, &session->done_tail, request);
+}
+
+/* check if two requests would fetch and decode the same thing */
+static int request_same(libcohost_request_t *a, libcohost_request_t *b)
+{
+	if (strcmp(a->url, b->url) != 0)
+		return 0;
+	if ((a->page == NULL) != (b->page == NULL) || (a->index == NULL) != (b->index == NULL))
+		return 0;
+	if (a->index && strcmp(a->index->key, b->index->key) != 0)
+		return 0;
+
+	return 1;
+}
+
+/* queue a request, or attach it to an identical one already in flight */
+static void request_enqueue(libcohost_session_t *session, libcohost_request_t *request)
+{
+	libcohost_request_t *leader = NULL, *it;
+	int i;
+
+	/* streamed requests run their item callbacks during the transfer */
+	if (request->stream == NULL)
+	{
+		for (i = 0; i < session->num_handles && leader == NULL; i++)
+		{
+			it = session->handles[i].request;
+			if (it && it->state == LIBCOHOST_REQUEST_ACTIVE && it->stream == NULL && request_same(it, request))
+				leader = it;
+		}
+
+		for (it = session->queued; it && leader == NULL; it = it->next)
+			if (it->stream == NULL && request_same(it, request))
+				leader = it;
+	}
+
+	if (leader == NULL)
+	{
+		if (session->limit && request->queued_at == 0)
+			request->queued_at = libcohost_limit_now();
+		request_list_push(&session->queued, &session->queued_tail, request);
+		return;
+	}
+
+	request->leader = leader;
+	request->coalesced_next = leader->coalesced;
+	leader->coalesced = request;
+	session->stats.coalesced++;
+}
+
+/* let the first coalesced request take over the transfer of a cancelled leader */
+static void request_handover(libcohost_session_t *session, libcohost_request_t *request)
+{
+	libcohost_request_t *heir = request->coalesced, *it, *prev;
+
+	request->coalesced = NULL;
+	heir->leader = NULL;
+	heir->coalesced = heir->coalesced_next;
+	heir->coalesced_next = NULL;
+	for (it = heir->coalesced; it; it = it->coalesced_next)
+		it->leader = heir;
+
+	heir->state = request->state;
+	heir->cache_key = request->cache_key;
+	heir->queued_at = request->queued_at;
+	heir->not_before = request->not_before;
+	heir->attempts = request->attempts;
+	heir->limited = request->limited;
+	request->limited = 0;
+
+	if (request->state == LIBCOHOST_REQUEST_QUEUED)
+	{
+		/* take its place in the queue */
+		prev = NULL;
+		for (it = session->queued; it && it != request; it = it->next)
+			prev = it;
+		heir->next = request->next;
+		if (prev)
+			prev->next = heir;
+		else
+			session->queued = heir;
+		if (session->queued_tail == request)
+			session->queued_tail = heir;
+	}
+	else
+	{
+		/* take over the handle and the arena the response is parsed into */
+		heir->handle = request->handle;
+		heir->handle->request = heir;
+		heir->arena = request->arena;
+		request->handle = NULL;
+		request->arena = NULL;
+	}
+}
+
+/* release everything a finished request holds */
+static void request_free(libcohost_request_t *request)
+{
+	/* coalesced requests only borrowed these */
+	if (request->leader)
+	{
+		request->json = NULL;
+		request->index = NULL;
+	}
+
+	libcohost_handle_release(request->handle);
+	if (request->arena)
+	{
+		/* arena trees go away in one piece */
+		if (request->json && request->arena->heap) cJSON_Delete(request->json);
+		libcohost_arena_free(request->arena);
+		free(request->arena);
+	}
+	else if (request->json)
+	{
+		cJSON_Delete(request->json);
+	}
+	if (request->stream)
 	{
-		if (session->curl) curl_easy_cleanup(session->curl);
+		libcohost_json_stream_free(request->stream);
+		free(request->stream);
+	}
+	if (request->index)
+	{
+		libcohost_json_index_free(request->index);
+		free(request->index);
+	}
+	if (request->page)
+	{
+		libcohost_page_free(request->page);
+		free(request->page);
+	}
+	free(request->url);
+	free(request);
+}
+
+/* give back the limiter slot a started request holds */
+static void request_unlimit(libcohost_session_t *session, libcohost_request_t *request, long status, unsigned long retry_after, uint64_t now)
+{
+	if (session->limit == NULL || !request->limited)
+		return;
+
+	libcohost_limit_release(session->limit, status, retry_after, now);
+	request->limited = 0;
+}
+
+/* cancel a request on the thread that owns the curl state */
+static void request_cancel(libcohost_session_t *session, libcohost_request_t *request)
+{
+	libcohost_request_t *prev, *it;
+
+	/* a coalesced request only has to leave its leader */
+	if (request->leader)
+	{
+		if (request->state != LIBCOHOST_REQUEST_QUEUED)
+			return;
+		prev = NULL;
+		for (it = request->leader->coalesced; it && it != request; it = it->coalesced_next)
+			prev = it;
+		if (prev)
+			prev->coalesced_next = request->coalesced_next;
+		else
+			request->leader->coalesced = request->coalesced_next;
+		request->leader = NULL;
+		request_finish(session, request, LIBCOHOST_RESULT_CANCELLED);
+		return;
+	}
+
+	/* whoever else wanted the response keeps the transfer going */
+	if (request->coalesced && (request->state == LIBCOHOST_REQUEST_QUEUED || request->state == LIBCOHOST_REQUEST_ACTIVE))
+	{
+		request_handover(session, request);
+		request_finish(session, request, LIBCOHOST_RESULT_CANCELLED);
+		return;
+	}
+
+	switch (request->state)
+	{
+		case LIBCOHOST_REQUEST_QUEUED:
+			/* unlink from the queue */
+			prev = NULL;
+			for (it = session->queued; it && it != request; it = it->next)
+				prev = it;
+			if (prev)
+				prev->next = request->next;
+			else
+				session->queued = request->next;
+			if (session->queued_tail == request)
+				session->queued_tail = prev;
+			request_finish(session, request, LIBCOHOST_RESULT_CANCELLED);
+			break;
+
+		case LIBCOHOST_REQUEST_ACTIVE:
+			/* abort the transfer, the connection goes back to the cache */
+			curl_multi_remove_handle(session->multi, request->handle->curl);
+			request_unlimit(session, request, 0, 0, libcohost_limit_now());
+			request_finish(session, request, LIBCOHOST_RESULT_CANCELLED);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* fill in request results from its handle and move it to the done list */
+static void request_complete(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle, int result)
+{
+	libcohost_arena_t *arena;
+
+	request->status = handle->status;
+	request->time_total = handle->time_total;
+	request->bytes_wire = handle->bytes_wire;
+	request->head = &handle->head;
+	request->body = &handle->body;
+
+	/* parse here, so with a worker thread the caller gets a ready tree */
+	/* streamed requests only hold a body here if it came from the cache, */
+	/* a recording, or was copied while recording, error bodies aren't fed */
+	if (result == LIBCOHOST_RESULT_OK && handle->body.len &&
+		!(request->stream && (handle->streamed || !STATUS_OK(handle->status))))
+	{
+		arena = libcohost_arena_use(request->arena);
+		if (request->stream)
+			libcohost_json_stream_feed(request->stream, handle->body.data, handle->body.len);
+		else if (request->index)
+		{
+			libcohost_json_index_build(request->index, request->index->key, &handle->body);
+			if (request->page)
+				libcohost_page_decode_index(request->page, request->index);
+		}
+		else
+			request->json = cJSON_ParseWithLength(handle->body.data, handle->body.len);
+		libcohost_arena_use(arena);
+	}
+
+	if (request->arena)
+	{
+		session->stats.json_allocs += request->arena->stats.allocs;
+		if (request->arena->stats.peak > session->stats.json_peak)
+			session->stats.json_peak = request->arena->stats.peak;
+	}
+
+	request_finish(session, request, result);
+}
+
+/* send request round again from the back of the queue, its handle goes back to the pool */
+static void request_requeue(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle)
+{
+	libcohost_handle_release(handle);
+	request->handle = NULL;
+	if (request->arena)
+	{
+		libcohost_arena_free(request->arena);
+		free(request->arena);
+		request->arena = NULL;
+	}
+	request->state = LIBCOHOST_REQUEST_QUEUED;
+	request_list_push(&session->queued, &session->queued_tail, request);
+}
+
+/* serve request from the cache or add validators for a conditional request */
+/* returns 1 if the request was answered without touching the network */
+static int request_cache_lookup(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle)
+{
+	char line[LIBCOHOST_CACHE_VALIDATOR_LEN + 32];
+	libcohost_cache_entry_t *entry;
+	struct curl_slist *headers = NULL;
+
+	/* cached responses are per account, logged out sessions share theirs */
+	request->cache_key = libcohost_hash(&session->user_id, sizeof(session->user_id), LIBCOHOST_HASH_SEED);
+	request->cache_key = libcohost_hash(&session->project_id, sizeof(session->project_id), request->cache_key);
+	if (session->session_id)
+		request->cache_key = libcohost_hash(session->session_id, strlen(session->session_id), request->cache_key);
+	request->cache_key = libcohost_hash(request->url, strlen(request->url), request->cache_key);
+
+	entry = libcohost_cache_find(session->cache, request->cache_key);
+	if (entry == NULL)
+	{
+		session->cache->stats.misses++;
+		return 0;
+	}
+
+	/* still fresh, no need to ask the server, no-cache responses never are */
+	if ((unsigned long)time(NULL) < entry->expires)
+	{
+		if (libcohost_cache_read(session->cache, entry, &handle->body) == LIBCOHOST_RESULT_OK)
+		{
+			session->cache->stats.hits++;
+			handle->status = 200;
+			handle->time_total = 0;
+			handle->bytes_wire = 0;
+			request->cached = 1;
+			request_complete(session, request, handle, LIBCOHOST_RESULT_OK);
+			return 1;
+		}
+
+		session->cache->stats.misses++;
+		return 0;
+	}
+
+	/* stale, revalidate */
+	if (entry->etag[0])
+	{
+		snprintf(line, sizeof(line), "If-None-Match: %s", entry->etag);
+		headers = curl_slist_append(headers, line);
+	}
+
+	if (entry->last_modified[0])
+	{
+		snprintf(line, sizeof(line), "If-Modified-Since: %s", entry->last_modified);
+		headers = curl_slist_append(headers, line);
+	}
+
+	handle->headers = headers;
+	curl_easy_setopt(handle->curl, CURLOPT_HTTPHEADER, headers);
+
+	return 0;
+}
+
+/* answer a 304 from disk or store a fresh response */
+/* returns 1 if the request goes round again */
+static int request_cache_update(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle)
+{
+	char etag[LIBCOHOST_CACHE_VALIDATOR_LEN];
+	char last_modified[LIBCOHOST_CACHE_VALIDATOR_LEN];
+	char cache_control[256];
+	libcohost_cache_entry_t *entry;
+	unsigned long expires;
+	char *max_age;
+	int store = 1;
+
+	/* work out how long the response may be served without asking */
+	expires = (unsigned long)time(NULL) + session->cache->fresh_seconds;
+	if (header_find(&handle->head, "Cache-Control:", cache_control, sizeof(cache_control)))
+	{
+		if (strstr(cache_control, "no-store"))
+			store = 0;
+		else if (strstr(cache_control, "no-cache"))
+			expires = 0; /* kept, but checked with the server every time */
+		else if ((max_age = strstr(cache_control, "max-age=")))
+			expires = (unsigned long)time(NULL) + strtoul(max_age + 8, NULL, 10);
+	}
+
+	if (handle->status == 304)
+	{
+		entry = libcohost_cache_find(session->cache, request->cache_key);
+		if (entry && libcohost_cache_read(session->cache, entry, &handle->body) == LIBCOHOST_RESULT_OK)
+		{
+			session->cache->stats.revalidated++;
+			entry->expires = expires;
+			handle->status = 200;
+			request->cached = 1;
+			if (!store)
+				libcohost_cache_remove(session->cache, request->cache_key);
+			return 0;
+		}
+
+		/* validators only come from the cache, without them the 304 is the server's */
+		if (handle->headers == NULL)
+			return 0;
+
+		/* the copy they came from is gone, so ask again without them */
+		request_requeue(session, request, handle);
+		return 1;
+	}
+	else if (handle->status == 200 && request->stream == NULL)
+	{
+		if (!store)
+		{
+			libcohost_cache_remove(session->cache, request->cache_key);
+			return 0;
+		}
+
+		if (!header_find(&handle->head, "ETag:", etag, sizeof(etag)))
+			etag[0] = '\0';
+		if (!header_find(&handle->head, "Last-Modified:", last_modified, sizeof(last_modified)))
+			last_modified[0] = '\0';
+
+		libcohost_cache_store(session->cache, request->cache_key, etag, last_modified, expires, handle->body.data, handle->body.len);
+	}
+
+	return 0;
+}
+
+/* report a finished transfer to the limiter and requeue it if it was throttled */
+/* returns 1 if the request goes round again */
+static int request_pace(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle, CURLcode result)
+{
+	char value[32];
+	unsigned long retry_after = 0;
+	uint64_t now, delay;
+
+	if (session->limit == NULL)
+		return 0;
+
+	now = libcohost_limit_now();
+	if (result == CURLE_OK && header_find(&handle->head, "Retry-After:", value, sizeof(value)))
+		retry_after = strtoul(value, NULL, 10);
+
+	request_unlimit(session, request, result == CURLE_OK ? handle->status : 0, retry_after, now);
+
+	if (result != CURLE_OK || (handle->status != 429 && handle->status != 503) ||
+		request->attempts >= LIBCOHOST_LIMIT_RETRIES)
+		return 0;
+
+	/* sit out Retry-After or the backoff, whichever is longer */
+	delay = libcohost_limit_backoff(session->limit, request->attempts++);
+	if ((uint64_t)retry_after * 1000000 > delay)
+		delay = (uint64_t)retry_after * 1000000;
+	request->not_before = now + delay;
+	session->limit->stats.retries++;
+
+	request_requeue(session, request, handle);
+
+	return 1;
+}
+
+/* finish a transfer that came back from curl or from a recording */
+static void request_done(libcohost_session_t *session, libcohost_request_t *request, libcohost_handle_t *handle, CURLcode result)
+{
+	if (request_pace(session, request, handle, result))
+		return;
+
+	if (result != CURLE_OK)
+	{
+		request_complete(session, request, handle, LIBCOHOST_RESULT_CURL_FAIL);
+		return;
+	}
+
+	transport_record(request->url, handle);
+
+	if (session->cache && request_cache_update(session, request, handle))
+		return;
+
+	request_complete(session, request, handle, LIBCOHOST_RESULT_OK);
+}
+
+/* hand queued requests to idle handles */
+static void requests_start(libcohost_session_t *session)
+{
+	libcohost_request_t *request, *prev;
+	libcohost_handle_t *handle;
+	uint64_t now = 0;
+
+	if (session->limit)
+		now = libcohost_limit_now();
+
+	while (session->queued)
+	{
+		/* first request that isn't sitting out a retry delay */
+		prev = NULL;
+		for (request = session->queued; request && request->not_before > now; request = request->next)
+			prev = request;
+		if (request == NULL)
+			break;
+
+		handle = libcohost_handle_acquire(session);
+		if (handle == NULL)
+			break;
+
+		/* wait for a token and room in the window */
+		if (session->limit)
+		{
+			if (!libcohost_limit_acquire(session->limit, request->queued_at, now))
+			{
+				libcohost_handle_release(handle);
+				break;
+			}
+			request->limited = 1;
+		}
+
+		/* unlink from the queue */
+		if (prev)
+			prev->next = request->next;
+		else
+			session->queued = request->next;
+		if (session->queued_tail == request)
+			session->queued_tail = prev;
+
+		/* the response tree gets an arena of its own, plain malloc if that fails */
+		request->arena = malloc(sizeof(libcohost_arena_t));
+		if (request->arena)
+			libcohost_arena_init(request->arena, session->arena_disabled);
+
+		/* setup transfer */
+		handle_prepare(session, handle, request->url);
+		handle->request = request;
+
+		request->handle = handle;
+		request->state = LIBCOHOST_REQUEST_ACTIVE;
+
+		if (session->cache && request_cache_lookup(session, request, handle))
+		{
+			/* the server never saw it */
+			request_unlimit(session, request, 0, 0, now);
+			continue;
+		}
+
+		/* recorded responses finish straight away */
+		if (transport_replaying())
+		{
+			request_done(session, request, handle, handle_replay(session, handle, request->url));
+			continue;
+		}
+
+		if (curl_multi_add_handle(session->multi, handle->curl) != CURLM_OK)
+		{
+			request_unlimit(session, request, 0, 0, now);
+			request_finish(session, request, LIBCOHOST_RESULT_CURL_FAIL);
+		}
+	}
+}
+
+/* pick up finished transfers from the multi handle */
+static void requests_collect(libcohost_session_t *session)
+{
+	libcohost_request_t *request;
+	libcohost_handle_t *handle;
+	CURLMsg *msg;
+	int num_msgs;
+
+	while ((msg = curl_multi_info_read(session->multi, &num_msgs)))
+	{
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&handle);
+		curl_multi_remove_handle(session->multi, msg->easy_handle);
+
+		request = handle->request;
+		handle_account(session, handle);
+
+		request_done(session, request, handle, msg->data.result);
+	}
+}
+
+/* fire callbacks of finished requests and free them */
+static void requests_dispatch(libcohost_session_t *session)
+{
+	libcohost_request_t *request, *next;
+
+	/* detach the list, so callbacks can safely submit or cancel */
+	request = session->done;
+	session->done = NULL;
+	session->done_tail = NULL;
+
+	while (request)
+	{
+		next = request->next;
+
+		if (request->callback)
+			request->callback(request, request->user);
+
+		session->num_requests--;
+		request_free(request);
+
+		request = next;
+	}
+}
+
+/* run one round of transfers, waiting up to timeout_ms for activity */
+/* shorten a poll timeout to when the next paced request may start */
+static int requests_wait(libcohost_session_t *session, int timeout_ms)
+{
+	libcohost_request_t *request;
+	uint64_t now, wait, soonest;
+
+	if (session->limit == NULL || session->queued == NULL)
+		return timeout_ms;
+
+	now = libcohost_limit_now();
+	soonest = UINT64_MAX;
+	for (request = session->queued; request; request = request->next)
+	{
+		wait = request->not_before > now ? request->not_before - now : 0;
+		if (wait < soonest)
+			soonest = wait;
+	}
+
+	wait = libcohost_limit_wait(session->limit, now);
+	if (soonest > wait)
+		wait = soonest;
+
+	/* nothing to wait for but the window, a finishing transfer wakes us */
+	if (wait && (wait + 999) / 1000 < (uint64_t)timeout_ms)
+		timeout_ms = (int)((wait + 999) / 1000);
+
+	return timeout_ms;
+}
+
+static void requests_run(libcohost_session_t *session, int timeout_ms, int always_wait)
+{
+	libcohost_request_t *done_tail = session->done_tail;
+	int running = 0;
+
+	requests_start(session);
+	timeout_ms = requests_wait(session, timeout_ms);
+
+	/* cache hits and replays finish in requests_start, don't sit on them */
+	if (session->done_tail != done_tail)
+		timeout_ms = 0;
+
+	curl_multi_perform(session->multi, &running);
+	if ((running || always_wait) && timeout_ms > 0)
+	{
+		curl_multi_poll(session->multi, NULL, 0, timeout_ms, NULL);
+		curl_multi_perform(session->multi, &running);
+	}
+
+	requests_collect(session);
+}
+
+/*
+ * worker thread
+ */
+
+/* push message into ring, returns 0 if it is full */
+static int ring_push(ring_t *ring, int type, libcohost_request_t *request)
+{
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+	if (head - tail == RING_SIZE)
+		return 0;
+
+	ring->messages[head & (RING_SIZE - 1)].type = type;
+	ring->messages[head & (RING_SIZE - 1)].request = request;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return 1;
+}
+
+/* pop message from ring, returns 0 if it is empty */
+static int ring_pop(ring_t *ring, message_t *message)
+{
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+	if (tail == head)
+		return 0;
+
+	*message = ring->messages[tail & (RING_SIZE - 1)];
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	return 1;
+}
+
+/* send message from the caller to the worker thread */
+static void worker_send(libcohost_session_t *session, int type, libcohost_request_t *request)
+{
+	worker_t *worker = session->worker;
+
+	/* the ring is sized so this only spins if the worker falls far behind */
+	while (!ring_push(&worker->inbox, type, request))
+	{
+		curl_multi_wakeup(session->multi);
+		sched_yield();
+	}
+
+	curl_multi_wakeup(session->multi);
+}
+
+/* handle a message on the thread that owns the curl state */
+static void worker_receive(libcohost_session_t *session, message_t *message)
+{
+	switch (message->type)
+	{
+		case MESSAGE_SUBMIT:
+			request_enqueue(session, message->request);
+			break;
+
+		case MESSAGE_CANCEL:
+			request_cancel(session, message->request);
+			break;
+
+		case MESSAGE_RELEASE:
+			request_free(message->request);
+			break;
+	}
+}
+
+/* worker thread entry point */
+static void *worker_main(void *data)
+{
+	libcohost_session_t *session = data;
+	worker_t *worker = session->worker;
+	libcohost_request_t *request;
+	message_t message;
+
+	while (atomic_load(&worker->running))
+	{
+		while (ring_pop(&worker->inbox, &message))
+			worker_receive(session, &message);
+
+		/* sleeps until a transfer has activity or the caller wakes us up */
+		requests_run(session, WORKER_POLL_TIMEOUT, 1);
+
+		/* hand finished requests over to the caller */
+		while ((request = session->done))
+		{
+			if (!ring_push(&worker->outbox, MESSAGE_DONE, request))
+				break;
+			session->done = request->next;
+			if (session->done == NULL)
+				session->done_tail = NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/* move network i/o onto a background thread that owns all curl state */
+int libcohost_worker_start(libcohost_session_t *session)
+{
+	worker_t *worker;
+
+	if (session->multi == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	if (session->worker)
+		return LIBCOHOST_RESULT_OK;
+
+	worker = calloc(1, sizeof(worker_t));
+	if (worker == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	atomic_init(&worker->inbox.head, 0);
+	atomic_init(&worker->inbox.tail, 0);
+	atomic_init(&worker->outbox.head, 0);
+	atomic_init(&worker->outbox.tail, 0);
+	atomic_init(&worker->running, 1);
+
+	session->worker = worker;
+	if (pthread_create(&worker->thread, NULL, worker_main, session) != 0)
+	{
+		session->worker = NULL;
+		free(worker);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* stop the background thread and take back the curl state */
+void libcohost_worker_stop(libcohost_session_t *session)
+{
+	worker_t *worker = session->worker;
+	libcohost_request_t *done = NULL, *done_tail = NULL;
+	message_t message;
+
+	if (worker == NULL)
+		return;
+
+	atomic_store(&worker->running, 0);
+	curl_multi_wakeup(session->multi);
+	pthread_join(worker->thread, NULL);
+
+	session->worker = NULL;
+
+	/* finished requests still get their callbacks from the next poll */
+	while (ring_pop(&worker->outbox, &message))
+		request_list_push(&done, &done_tail, message.request);
+
+	/* these left the done list first, so they go back in front of it */
+	if (done)
+	{
+		done_tail->next = session->done;
+		if (session->done == NULL)
+			session->done_tail = done_tail;
+		session->done = done;
+	}
+
+	while (ring_pop(&worker->inbox, &message))
+		worker_receive(session, &message);
+
+	free(worker);
+}
+
+/*
+ * public async interface
+ */
+
+/* create a GET request to be configured and queued with libcohost_request_queue() */
+libcohost_request_t *libcohost_request_new(const char *url, libcohost_callback_t callback, void *user)
+{
+	libcohost_request_t *request;
+	size_t len;
+
+	if (url == NULL)
+		return NULL;
+
+	request = calloc(1, sizeof(libcohost_request_t));
+	if (request == NULL)
+		return NULL;
+
+	len = strlen(url);
+	request->url = malloc(len + 1);
+	if (request->url == NULL)
+	{
+		free(request);
+		return NULL;
+	}
+	memcpy(request->url, url, len + 1);
+
+	request->state = LIBCOHOST_REQUEST_QUEUED;
+	request->callback = callback;
+	request->user = user;
+
+	return request;
+}
+
+/* parse the response incrementally, emitting each object of the array under key */
+int libcohost_request_stream_set(libcohost_request_t *request, const char *key, libcohost_json_item_callback_t callback, void *user)
+{
+	if (request->stream == NULL)
+	{
+		request->stream = malloc(sizeof(libcohost_json_stream_t));
+		if (request->stream == NULL)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+	else
+	{
+		libcohost_json_stream_free(request->stream);
+	}
+
+	libcohost_json_stream_init(request->stream, key, callback, user);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* keep the raw response in request->index and only index its elements */
+int libcohost_request_index_set(libcohost_request_t *request, const char *key)
+{
+	if (request->index == NULL)
+	{
+		request->index = calloc(1, sizeof(libcohost_json_index_t));
+		if (request->index == NULL)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	strncpy(request->index->key, key ? key : "", LIBCOHOST_JSON_KEY_LEN - 1);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* give a request an empty page to decode into */
+static int request_page_alloc(libcohost_request_t *request)
+{
+	if (request->page)
+		return LIBCOHOST_RESULT_OK;
+
+	request->page = malloc(sizeof(libcohost_page_t));
+	if (request->page == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	if (libcohost_page_init(request->page) != LIBCOHOST_RESULT_OK)
+	{
+		free(request->page);
+		request->page = NULL;
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* stream item callback decoding posts into the request page */
+static void request_page_item(void *json, void *user)
+{
+	libcohost_page_post_add(user, json);
+}
+
+/* decode the response into request->page as it streams in, no tree is kept */
+int libcohost_request_page_set(libcohost_request_t *request)
+{
+	if (request_page_alloc(request) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	return libcohost_request_stream_set(request, "items", request_page_item, request->page);
+}
+
+/* keep the response and decode it in situ into request->page once complete */
+int libcohost_request_page_insitu_set(libcohost_request_t *request)
+{
+	if (libcohost_request_index_set(request, "items") != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	if (request_page_alloc(request) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* hand a request created with libcohost_request_new() to the session */
+int libcohost_request_queue(libcohost_session_t *session, libcohost_request_t *request)
+{
+	if (session->multi == NULL || request == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	if (session->num_requests >= LIBCOHOST_MAX_REQUESTS)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	session->num_requests++;
+
+	if (session->worker)
+		worker_send(session, MESSAGE_SUBMIT, request);
+	else
+		request_enqueue(session, request);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* queue a GET request without blocking, callback fires from libcohost_poll() */
+libcohost_request_t *libcohost_request_submit(libcohost_session_t *session, const char *url, libcohost_callback_t callback, void *user)
+{
+	libcohost_request_t *request;
+
+	request = libcohost_request_new(url, callback, user);
+	if (request == NULL)
+		return NULL;
+
+	if (libcohost_request_queue(session, request) != LIBCOHOST_RESULT_OK)
+	{
+		request_free(request);
+		return NULL;
+	}
+
+	return request;
+}
+
+/* fetch one page of a project's posts, decoded into request->page */
+libcohost_request_t *libcohost_project_posts(libcohost_session_t *session, const char *handle, int page, libcohost_callback_t callback, void *user)
+{
+	libcohost_request_t *request;
+	char url[512];
+
+	snprintf(url, sizeof(url), COHOST_API_PROJECT "%s/posts?page=%d", handle, page);
+
+	request = libcohost_request_new(url, callback, user);
+	if (request == NULL)
+		return NULL;
+
+	if (libcohost_request_page_insitu_set(request) != LIBCOHOST_RESULT_OK || libcohost_request_queue(session, request) != LIBCOHOST_RESULT_OK)
+	{
+		request_free(request);
+		return NULL;
+	}
+
+	return request;
+}
+
+/* cancel a queued or active request, its callback fires with LIBCOHOST_RESULT_CANCELLED */
+void libcohost_request_cancel(libcohost_session_t *session, libcohost_request_t *request)
+{
+	if (request == NULL || request->cancelled)
+		return;
+
+	request->cancelled = 1;
+
+	if (session->worker)
+		worker_send(session, MESSAGE_CANCEL, request);
+	else
+		request_cancel(session, request);
+}
+
+/* run transfers and fire completion callbacks, waiting up to timeout_ms for activity */
+int libcohost_poll(libcohost_session_t *session, int timeout_ms)
+{
+	worker_t *worker = session->worker;
+	message_t message;
+
+	if (session->multi == NULL)
+		return 0;
+
+	/* with a worker thread this only drains finished requests and never blocks */
+	if (worker)
+	{
+		while (ring_pop(&worker->outbox, &message))
+		{
+			if (message.request->callback)
+				message.request->callback(message.request, message.request->user);
+
+			session->num_requests--;
+			worker_send(session, MESSAGE_RELEASE, message.request);
+		}
+
+		return session->num_requests;
+	}
+
+	requests_run(session, timeout_ms, 0);
+	requests_dispatch(session);
+
+	/* handles freed by callbacks can pick up queued work straight away */
+	requests_start(session);
+
+	return session->num_requests;
+}
+
+/* perform a blocking GET request on an acquired handle */
+int libcohost_get(libcohost_session_t *session, libcohost_handle_t *handle, const char *url)
+{
+	/* the pool belongs to the worker thread while it runs */
+	if (session->worker)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	handle_prepare(session, handle, url);
+
+	if (transport_replaying())
+		return handle_replay(session, handle, url) == CURLE_OK ? LIBCOHOST_RESULT_OK : LIBCOHOST_RESULT_CURL_FAIL;
+
+	if (curl_easy_perform(handle->curl) != CURLE_OK)
+		return LIBCOHOST_RESULT_CURL_FAIL;
+
+	handle_account(session, handle);
+	transport_record(url, handle);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* choose between http/2 multiplexing and plain http/1.1 */
+void libcohost_session_http_version_set(libcohost_session_t *session, int http_version)
+{
+	session->http_version = http_version;
+}
+
+/* enable or disable compressed transfers, enabled by default */
+void libcohost_session_compression_set(libcohost_session_t *session, int enabled)
+{
+	session->compression_disabled = !enabled;
+}
+
+/* enable or disable arena allocation of response trees, enabled by default */
+/* when disabled allocations are still counted in the session stats */
+void libcohost_session_arena_set(libcohost_session_t *session, int enabled)
+{
+	session->arena_disabled = !enabled;
+}
+
+/* serve async requests through an on-disk http cache, NULL to detach */
+void libcohost_session_cache_set(libcohost_session_t *session, libcohost_cache_t *cache)
+{
+	session->cache = cache;
+}
+
+/* pace async requests and retry throttled ones through a limiter, NULL to detach */
+void libcohost_session_limit_set(libcohost_session_t *session, libcohost_limit_t *limit)
+{
+	session->limit = limit;
+}
+
+/* copy out the session transfer counters */
+void libcohost_session_stats(libcohost_session_t *session, libcohost_stats_t *stats)
+{
+	memcpy(stats, &session->stats, sizeof(libcohost_stats_t));
+}
+
+/* setup a session without logging in */
+int libcohost_session_init(libcohost_session_t *session)
+{
+	int r;
+
+	memset(session, 0, sizeof(libcohost_session_t));
+
+	/* setup curl */
+	r = share_init(session);
+	if (r != LIBCOHOST_RESULT_OK)
+		return r;
+
+	session->multi = curl_multi_init();
+	if (session->multi == NULL)
+		return LIBCOHOST_RESULT_CURL_INIT_FAIL;
+
+	/* concurrent requests to the same host share one http/2 connection */
+	curl_multi_setopt(session->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* create a new cohost session */
+int libcohost_session_new(libcohost_session_t *session, char *email, char *password, char *cookie_save_filename)
+{
+	static char url[512];
+	static char post[1024];
+	libcohost_handle_t *handle;
+	cJSON *json = NULL;
+	cJSON *json_item = NULL;
+	int r;
+
+	UNUSED(cookie_save_filename);
+
+	if (email == NULL || password == NULL)
+		return LIBCOHOST_RESULT_BAD_CREDENTIALS;
+
+	r = libcohost_session_init(session);
+	if (r != LIBCOHOST_RESULT_OK)
+		return r;
+
+	handle = libcohost_handle_acquire(session);
+	if (handle == NULL)
+		return LIBCOHOST_RESULT_CURL_INIT_FAIL;
+
+	/* setup url for GET request */
+	snprintf(url, sizeof(url), COHOST_API_LOGIN "salt?email=%s", email);
+
+	/* send GET request */
+	r = libcohost_get(session, handle, url);
+	libcohost_handle_release(handle);
+
+	return r;
+}
+
+/* destroy an active session */
+void libcohost_session_destroy(libcohost_session_t *session)
+{
+	libcohost_request_t *request;
+	int i;
+
+	if (session)
+	{
+		/* take the curl state back from the worker thread */
+		libcohost_worker_stop(session);
+
+		/* cancel everything in flight and let callbacks clean up */
+		if (session->multi)
+		{
+			while (session->queued)
+				request_cancel(session, session->queued);
+			for (i = 0; i < session->num_handles; i++)
+			{
+				/* coalesced requests take over a cancelled transfer, so repeat */
+				while ((request = session->handles[i].request) && request->state == LIBCOHOST_REQUEST_ACTIVE)
+					request_cancel(session, request);
+			}
+			requests_dispatch(session);
+			curl_multi_cleanup(session->multi);
+			session->multi = NULL;
+		}
+
+		for (i = 0; i < session->num_handles; i++)
+		{
+			curl_easy_cleanup(session->handles[i].curl);
+			curl_slist_free_all(session->handles[i].headers);
+			libcohost_buffer_free(&session->handles[i].head);
+			libcohost_buffer_free(&session->handles[i].body);
+		}
+		session->num_handles = 0;
+
+		/* the share can only go once no handle uses it */
+		if (session->share) curl_share_cleanup(session->share);
 		if (session->session_id) free(session->session_id);
+		session->share = NULL;
+		session->session_id = NULL;
 	}
 }
 
@@ -44,6 +44,20 @@ extern "C" {
 #endif
 
 #include <stdlib.h>
+#include <stdint.h>
+
+/* max number of pooled curl handles per session */
+#ifndef LIBCOHOST_MAX_HANDLES
+#define LIBCOHOST_MAX_HANDLES (8)
+#endif
+
+/* max number of async requests in flight per session, must be a power of two */
+#ifndef LIBCOHOST_MAX_REQUESTS
+#define LIBCOHOST_MAX_REQUESTS (1024)
+#endif
+
+/* seed for the first libcohost_hash() call */
+#define LIBCOHOST_HASH_SEED (0xcbf29ce484222325ULL)
 
 /* result types */
 enum {
@@ -53,7 +67,21 @@ enum {
 	LIBCOHOST_RESULT_COULDNT_CONNECT,
 	LIBCOHOST_RESULT_BAD_CREDENTIALS,
 	LIBCOHOST_RESULT_CURL_INIT_FAIL,
-	LIBCOHOST_RESULT_CURL_FAIL
+	LIBCOHOST_RESULT_CURL_FAIL,
+	LIBCOHOST_RESULT_CANCELLED
+};
+
+/* http versions */
+enum {
+	LIBCOHOST_HTTP_2,
+	LIBCOHOST_HTTP_1_1
+};
+
+/* async request states */
+enum {
+	LIBCOHOST_REQUEST_QUEUED,
+	LIBCOHOST_REQUEST_ACTIVE,
+	LIBCOHOST_REQUEST_DONE
 };
 
 /* session flags */
@@ -64,13 +92,100 @@ enum {
 	LIBCOHOST_FLAG_MODMODE = 1 << 3
 };
 
+/* growable byte buffer, always nul terminated once allocated */
+typedef struct libcohost_buffer_t {
+	char *data;
+	size_t len;
+	size_t size;
+} libcohost_buffer_t;
+
+typedef struct libcohost_request_t libcohost_request_t;
+typedef struct libcohost_cache_t libcohost_cache_t;
+typedef struct libcohost_limit_t libcohost_limit_t;
+
+/* async request completion callback */
+typedef void (*libcohost_callback_t)(libcohost_request_t *request, void *user);
+
+/* pooled curl handle with its own response buffers */
+typedef struct libcohost_handle_t {
+	void *curl;
+	int busy;
+	libcohost_request_t *request;
+	long status;
+	unsigned long time_total;
+	unsigned long bytes_wire;
+	void *headers;
+	libcohost_buffer_t head;
+	libcohost_buffer_t body;
+	int streamed; /* body bytes already went to the request's stream */
+} libcohost_handle_t;
+
+/* async request, owned by the library until its callback has returned */
+struct libcohost_request_t {
+	char *url;
+	int state;
+	int result;
+	int cancelled;
+	int cached;
+	uint64_t cache_key;
+	long status;
+	unsigned long time_total; /* microseconds */
+	unsigned long bytes_wire; /* body size before content decoding */
+	libcohost_buffer_t *head;
+	libcohost_buffer_t *body;
+	void *json;
+	struct libcohost_json_stream_t *stream;
+	struct libcohost_json_index_t *index;
+	struct libcohost_arena_t *arena;
+	struct libcohost_page_t *page;
+	libcohost_handle_t *handle;
+	libcohost_callback_t callback;
+	void *user;
+	libcohost_request_t *next;
+	libcohost_request_t *leader; /* set while riding on another request's transfer */
+	libcohost_request_t *coalesced; /* requests riding on this one */
+	libcohost_request_t *coalesced_next;
+	int attempts; /* retries after being throttled */
+	int limited; /* holds a slot in the limiter window */
+	uint64_t queued_at; /* limiter clock, only kept with a limiter */
+	uint64_t not_before;
+};
+
+/* session transfer counters */
+typedef struct libcohost_stats_t {
+	unsigned long requests;
+	unsigned long conn_reused;
+	unsigned long conn_new;
+	unsigned long http2;
+	unsigned long bytes_wire;
+	unsigned long bytes_decoded;
+	unsigned long json_allocs;
+	unsigned long json_peak;
+	unsigned long coalesced; /* requests served by another's transfer */
+} libcohost_stats_t;
+
 /* cohost session */
 typedef struct libcohost_session_t {
 	unsigned int user_id;
 	unsigned int project_id;
 	unsigned int flags;
 	char *session_id;
-	void *curl;
+	int http_version;
+	int compression_disabled;
+	int arena_disabled;
+	libcohost_cache_t *cache;
+	libcohost_limit_t *limit;
+	void *share;
+	libcohost_handle_t handles[LIBCOHOST_MAX_HANDLES];
+	int num_handles;
+	void *multi;
+	libcohost_request_t *queued;
+	libcohost_request_t *queued_tail;
+	libcohost_request_t *done;
+	libcohost_request_t *done_tail;
+	int num_requests;
+	void *worker;
+	libcohost_stats_t stats;
 } libcohost_session_t;
 
 /* startup library */
@@ -82,12 +197,95 @@ void libcohost_quit(void);
 /* get a string representing a function result */
 const char *libcohost_result_string(int r);
 
+/* setup a session without logging in, e.g. to talk to a stand-in server */
+int libcohost_session_init(libcohost_session_t *session);
+
 /* login to cohost.org */
 int libcohost_session_new(libcohost_session_t *session, char *email, char *password, char *cookie_save_filename);
 
 /* destroy an active session */
 void libcohost_session_destroy(libcohost_session_t *session);
 
+/* choose between http/2 multiplexing (the default) and plain http/1.1 */
+/* applies to requests started afterwards, set it before starting the worker thread */
+void libcohost_session_http_version_set(libcohost_session_t *session, int http_version);
+
+/* enable or disable compressed transfers, enabled by default */
+/* applies to requests started afterwards, set it before starting the worker thread */
+void libcohost_session_compression_set(libcohost_session_t *session, int enabled);
+
+/* enable or disable arena allocation of response trees, enabled by default */
+/* when disabled allocations are still counted in the session stats */
+void libcohost_session_arena_set(libcohost_session_t *session, int enabled);
+
+/* serve async requests through an on-disk http cache, NULL to detach */
+/* entries are keyed by the login as well as the url, sessions without one share them */
+/* the session does not take ownership, set it before starting the worker thread */
+void libcohost_session_cache_set(libcohost_session_t *session, libcohost_cache_t *cache);
+
+/* pace async requests and retry throttled ones through a limiter, NULL to detach */
+/* the session does not take ownership, set it before starting the worker thread */
+void libcohost_session_limit_set(libcohost_session_t *session, libcohost_limit_t *limit);
+
+/* copy out the session transfer counters */
+void libcohost_session_stats(libcohost_session_t *session, libcohost_stats_t *stats);
+
+/* take an idle handle from the session pool, warming up a new one if needed */
+/* returns NULL if every handle is busy */
+libcohost_handle_t *libcohost_handle_acquire(libcohost_session_t *session);
+
+/* return a handle to the session pool, keeping its connection and buffers */
+void libcohost_handle_release(libcohost_handle_t *handle);
+
+/* perform a blocking GET request on an acquired handle */
+/* the response stays in the handle buffers until it is reused */
+/* not available while the worker thread runs */
+int libcohost_get(libcohost_session_t *session, libcohost_handle_t *handle, const char *url);
+
+/* queue a GET request without blocking, callback fires from libcohost_poll() */
+/* returns NULL on failure */
+libcohost_request_t *libcohost_request_submit(libcohost_session_t *session, const char *url, libcohost_callback_t callback, void *user);
+
+/* create a GET request to be configured and queued with libcohost_request_queue() */
+/* returns NULL on failure */
+libcohost_request_t *libcohost_request_new(const char *url, libcohost_callback_t callback, void *user);
+
+/* hand a request created with libcohost_request_new() to the session */
+/* on failure the request still belongs to the caller */
+int libcohost_request_queue(libcohost_session_t *session, libcohost_request_t *request);
+
+/* cancel a queued or active request, its callback fires with LIBCOHOST_RESULT_CANCELLED */
+void libcohost_request_cancel(libcohost_session_t *session, libcohost_request_t *request);
+
+/* run transfers and fire completion callbacks, waiting up to timeout_ms for activity */
+/* with the worker thread running this only drains finished requests and never blocks */
+/* returns the number of requests still in flight */
+int libcohost_poll(libcohost_session_t *session, int timeout_ms);
+
+/* move network i/o onto a background thread that owns all curl state */
+/* finished requests are handed back through a lock-free queue drained by libcohost_poll() */
+int libcohost_worker_start(libcohost_session_t *session);
+
+/* stop the background thread and take back the curl state */
+void libcohost_worker_stop(libcohost_session_t *session);
+
+/* 64-bit fnv-1a hash, chain calls by passing the previous result as seed */
+uint64_t libcohost_hash(const void *data, size_t len, uint64_t seed);
+
+/* make sure buffer can hold at least size bytes plus a nul terminator */
+/* returns LIBCOHOST_RESULT_ALLOC_FAIL on failure */
+int libcohost_buffer_reserve(libcohost_buffer_t *buffer, size_t size);
+
+/* append bytes to buffer, growing it geometrically */
+/* returns LIBCOHOST_RESULT_ALLOC_FAIL on failure */
+int libcohost_buffer_append(libcohost_buffer_t *buffer, const void *data, size_t len);
+
+/* empty buffer but keep its backing store for reuse */
+void libcohost_buffer_reset(libcohost_buffer_t *buffer);
+
+/* release buffer backing store */
+void libcohost_buffer_free(libcohost_buffer_t *buffer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,230 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "thirdparty/cJSON.h"
+
+#include "libcohost_arena.h"
+
+/* every allocation is rounded up to this */
+#define ARENA_ALIGN (16)
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+struct libcohost_arena_block_t {
+	libcohost_arena_block_t *next;
+	size_t size;
+	size_t used;
+	size_t pad;
+};
+
+/* prepended to cjson allocations so free can tell arena memory apart */
+typedef struct hook_header_t {
+	libcohost_arena_t *arena; /* NULL for plain malloc, heap mode arenas are only counted */
+	size_t size;
+} hook_header_t;
+
+/* arena receiving cjson allocations on this thread */
+static _Thread_local libcohost_arena_t *arena_current = NULL;
+
+/* setup arena, with heap set allocations go to malloc and are only counted */
+void libcohost_arena_init(libcohost_arena_t *arena, int heap)
+{
+	memset(arena, 0, sizeof(libcohost_arena_t));
+	arena->heap = heap;
+}
+
+/* count an allocation of size bytes */
+static void arena_count(libcohost_arena_t *arena, size_t size)
+{
+	arena->stats.allocs++;
+	arena->stats.bytes += size;
+	if (arena->stats.bytes > arena->stats.peak)
+		arena->stats.peak = arena->stats.bytes;
+}
+
+/* allocate size bytes aligned for any cjson node */
+void *libcohost_arena_alloc(libcohost_arena_t *arena, size_t size)
+{
+	libcohost_arena_block_t *block;
+	size_t block_size;
+	void *p;
+
+	size = ARENA_ROUND(size);
+
+	block = arena->blocks;
+	if (block == NULL || block->size - block->used < size)
+	{
+		/* oversized allocations get a block of their own */
+		block_size = LIBCOHOST_ARENA_BLOCK_SIZE;
+		if (size > block_size - sizeof(libcohost_arena_block_t))
+			block_size = size + sizeof(libcohost_arena_block_t);
+
+		block = malloc(block_size);
+		if (block == NULL)
+			return NULL;
+
+		block->size = block_size;
+		block->used = sizeof(libcohost_arena_block_t);
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->stats.blocks++;
+	}
+
+	p = (char *)block + block->used;
+	block->used += size;
+
+	arena_count(arena, size);
+
+	return p;
+}
+
+/* drop all allocations but keep the first block for reuse */
+void libcohost_arena_reset(libcohost_arena_t *arena)
+{
+	libcohost_arena_block_t *block, *next;
+
+	arena->stats.bytes = 0;
+
+	if (arena->blocks == NULL)
+		return;
+
+	/* the oldest block is the last in the list */
+	for (block = arena->blocks; block->next; block = next)
+	{
+		next = block->next;
+		free(block);
+		arena->stats.blocks--;
+	}
+
+	block->used = sizeof(libcohost_arena_block_t);
+	arena->blocks = block;
+}
+
+/* release all blocks */
+void libcohost_arena_free(libcohost_arena_t *arena)
+{
+	libcohost_arena_block_t *block, *next;
+
+	for (block = arena->blocks; block; block = next)
+	{
+		next = block->next;
+		free(block);
+	}
+
+	arena->blocks = NULL;
+	arena->stats.blocks = 0;
+	arena->stats.bytes = 0;
+}
+
+/* route cjson allocations on the calling thread to arena, NULL for malloc */
+libcohost_arena_t *libcohost_arena_use(libcohost_arena_t *arena)
+{
+	libcohost_arena_t *prev = arena_current;
+	arena_current = arena;
+	return prev;
+}
+
+/* get the arena active on the calling thread */
+libcohost_arena_t *libcohost_arena_current(void)
+{
+	return arena_current;
+}
+
+/* cjson malloc hook */
+static void *hook_malloc(size_t size)
+{
+	libcohost_arena_t *arena = arena_current;
+	hook_header_t *header;
+
+	if (arena && !arena->heap)
+	{
+		header = libcohost_arena_alloc(arena, sizeof(hook_header_t) + size);
+		if (header == NULL)
+			return NULL;
+		header->arena = arena;
+	}
+	else
+	{
+		header = malloc(sizeof(hook_header_t) + size);
+		if (header == NULL)
+			return NULL;
+		header->arena = arena;
+
+		/* heap mode keeps counting so both paths can be compared */
+		if (arena)
+			arena_count(arena, ARENA_ROUND(sizeof(hook_header_t) + size));
+	}
+
+	header->size = size;
+
+	return header + 1;
+}
+
+/* cjson free hook, arena memory goes away with its arena */
+/* heap mode trees must be freed before their arena, as request_free() does */
+static void hook_free(void *pointer)
+{
+	hook_header_t *header;
+
+	if (pointer == NULL)
+		return;
+
+	header = (hook_header_t *)pointer - 1;
+	if (header->arena && !header->arena->heap)
+		return;
+
+	/* so the peak is what was held at once, like in an arena */
+	if (header->arena)
+		header->arena->stats.bytes -= ARENA_ROUND(sizeof(hook_header_t) + header->size);
+
+	free(header);
+}
+
+/* install the cjson allocation hooks, done by libcohost_init() */
+void libcohost_arena_hooks_install(void)
+{
+	cJSON_Hooks hooks;
+
+	hooks.malloc_fn = hook_malloc;
+	hooks.free_fn = hook_free;
+
+	cJSON_InitHooks(&hooks);
+}
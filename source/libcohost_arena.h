@@ -0,0 +1,98 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_ARENA_H_
+#define _LIBCOHOST_ARENA_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdlib.h>
+
+/* size of each block requested from the system */
+#ifndef LIBCOHOST_ARENA_BLOCK_SIZE
+#define LIBCOHOST_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+/* arena block, allocations are bumped out of data */
+typedef struct libcohost_arena_block_t libcohost_arena_block_t;
+
+/* allocation counters */
+typedef struct libcohost_arena_stats_t {
+	unsigned long allocs;
+	unsigned long bytes;
+	unsigned long peak;
+	unsigned long blocks;
+} libcohost_arena_stats_t;
+
+/* bump allocator that is released all at once */
+typedef struct libcohost_arena_t {
+	libcohost_arena_block_t *blocks;
+	int heap;
+	libcohost_arena_stats_t stats;
+} libcohost_arena_t;
+
+/* setup arena, with heap set allocations go to malloc and are only counted */
+void libcohost_arena_init(libcohost_arena_t *arena, int heap);
+
+/* allocate size bytes aligned for any cjson node */
+/* returns NULL on failure */
+void *libcohost_arena_alloc(libcohost_arena_t *arena, size_t size);
+
+/* drop all allocations but keep the first block for reuse */
+void libcohost_arena_reset(libcohost_arena_t *arena);
+
+/* release all blocks */
+void libcohost_arena_free(libcohost_arena_t *arena);
+
+/* route cjson allocations on the calling thread to arena, NULL for malloc */
+/* returns the previously active arena */
+libcohost_arena_t *libcohost_arena_use(libcohost_arena_t *arena);
+
+/* get the arena active on the calling thread */
+libcohost_arena_t *libcohost_arena_current(void);
+
+/* install the cjson allocation hooks, done by libcohost_init() */
+/* strings from cJSON_Print() must then be released with cJSON_free() */
+void libcohost_arena_hooks_install(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_ARENA_H_ */
@@ -0,0 +1,469 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libcohost_cache.h"
+
+/* index file identification */
+#define INDEX_MAGIC (0x49434843) /* "CHCI" */
+#define INDEX_VERSION (1)
+#define INDEX_NAME "index"
+
+/* initial entry capacity */
+#define ENTRIES_MIN (64)
+
+/* seconds between index writes while entries change, a crash loses at most these */
+#define INDEX_INTERVAL (10)
+
+/* on-disk index header */
+typedef struct index_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t num_entries;
+	unsigned long clock;
+} index_header_t;
+
+/* build path of a file inside the cache directory */
+static void cache_path(libcohost_cache_t *cache, char *out, size_t len, uint64_t key)
+{
+	snprintf(out, len, "%s/%016llx", cache->path, (unsigned long long)key);
+}
+
+/* slot of key in the open addressed table, or the empty slot it would go in */
+/* keys are hashes already, so their low bits pick the first slot */
+static int cache_slot(libcohost_cache_t *cache, uint64_t key)
+{
+	int mask = cache->num_slots - 1;
+	int slot = (int)(key & (uint64_t)mask);
+
+	while (cache->slots[slot] >= 0 && cache->keys[cache->slots[slot]] != key)
+		slot = (slot + 1) & mask;
+
+	return slot;
+}
+
+/* entry index of key, -1 if it isn't cached */
+static int cache_index_of(libcohost_cache_t *cache, uint64_t key)
+{
+	if (cache->num_slots == 0)
+		return -1;
+
+	return cache->slots[cache_slot(cache, key)];
+}
+
+/* empty a slot, pulling later entries of its probe run back into the gap */
+static void cache_slot_clear(libcohost_cache_t *cache, int slot)
+{
+	int mask = cache->num_slots - 1;
+	int next = slot, home;
+
+	cache->slots[slot] = -1;
+
+	for (;;)
+	{
+		next = (next + 1) & mask;
+		if (cache->slots[next] < 0)
+			return;
+
+		/* entries whose first slot lies between the gap and here stay put */
+		home = (int)(cache->keys[cache->slots[next]] & (uint64_t)mask);
+		if (slot <= next ? (slot < home && home <= next) : (slot < home || home <= next))
+			continue;
+
+		cache->slots[slot] = cache->slots[next];
+		cache->slots[next] = -1;
+		slot = next;
+	}
+}
+
+/* rebuild the slot table for the current capacity */
+static int cache_rehash(libcohost_cache_t *cache)
+{
+	int *slots;
+	int i, num_slots = cache->max_entries * 2;
+
+	slots = malloc(sizeof(int) * num_slots);
+	if (slots == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	free(cache->slots);
+	cache->slots = slots;
+	cache->num_slots = num_slots;
+
+	for (i = 0; i < num_slots; i++)
+		cache->slots[i] = -1;
+	for (i = 0; i < cache->num_entries; i++)
+		cache->slots[cache_slot(cache, cache->keys[i])] = i;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* make sure there is room for one more entry */
+static int cache_grow(libcohost_cache_t *cache)
+{
+	libcohost_cache_entry_t *entries;
+	uint64_t *keys;
+	int max_entries;
+
+	if (cache->num_entries < cache->max_entries)
+		return LIBCOHOST_RESULT_OK;
+
+	max_entries = cache->max_entries ? cache->max_entries * 2 : ENTRIES_MIN;
+
+	keys = realloc(cache->keys, sizeof(uint64_t) * max_entries);
+	if (keys == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+	cache->keys = keys;
+
+	entries = realloc(cache->entries, sizeof(libcohost_cache_entry_t) * max_entries);
+	if (entries == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+	cache->entries = entries;
+
+	cache->max_entries = max_entries;
+
+	/* at most half full, so probe runs stay short */
+	return cache_rehash(cache);
+}
+
+/* drop entry and its body file, the last entry moves into its slot */
+static void cache_remove(libcohost_cache_t *cache, int index)
+{
+	char path[1024];
+
+	cache_path(cache, path, sizeof(path), cache->keys[index]);
+	remove(path);
+
+	cache_slot_clear(cache, cache_slot(cache, cache->keys[index]));
+
+	cache->stats.bytes -= cache->entries[index].size;
+	cache->num_entries--;
+	cache->dirty = 1;
+
+	if (index != cache->num_entries)
+	{
+		cache->keys[index] = cache->keys[cache->num_entries];
+		cache->entries[index] = cache->entries[cache->num_entries];
+		cache->slots[cache_slot(cache, cache->keys[index])] = index;
+	}
+}
+
+/* evict least recently used entries until size more bytes fit */
+static void cache_evict(libcohost_cache_t *cache, size_t size)
+{
+	int i, oldest;
+
+	while (cache->num_entries && cache->stats.bytes + size > cache->max_bytes)
+	{
+		oldest = 0;
+		for (i = 1; i < cache->num_entries; i++)
+			if (cache->entries[i].used < cache->entries[oldest].used)
+				oldest = i;
+
+		cache_remove(cache, oldest);
+		cache->stats.evictions++;
+	}
+}
+
+/* load the index written by the last store or close */
+static void cache_index_read(libcohost_cache_t *cache)
+{
+	char path[1024];
+	index_header_t header;
+	FILE *file;
+	uint32_t i;
+
+	snprintf(path, sizeof(path), "%s/" INDEX_NAME, cache->path);
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+		return;
+
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header.magic != INDEX_MAGIC ||
+		header.version != INDEX_VERSION ||
+		header.entry_size != sizeof(libcohost_cache_entry_t))
+	{
+		fclose(file);
+		return;
+	}
+
+	cache->clock = header.clock;
+
+	for (i = 0; i < header.num_entries; i++)
+	{
+		if (cache_grow(cache) != LIBCOHOST_RESULT_OK)
+			break;
+		if (fread(&cache->entries[cache->num_entries], sizeof(libcohost_cache_entry_t), 1, file) != 1)
+			break;
+
+		/* a damaged index may list a key twice, the first one wins */
+		if (cache_index_of(cache, cache->entries[cache->num_entries].key) >= 0)
+			continue;
+
+		cache->keys[cache->num_entries] = cache->entries[cache->num_entries].key;
+		cache->slots[cache_slot(cache, cache->keys[cache->num_entries])] = cache->num_entries;
+		cache->stats.bytes += cache->entries[cache->num_entries].size;
+		cache->num_entries++;
+	}
+
+	fclose(file);
+
+	/* the cap may have shrunk since the index was written */
+	cache_evict(cache, 0);
+}
+
+/* write the index so the next start knows what is on disk */
+static void cache_index_write(libcohost_cache_t *cache)
+{
+	char path[1024], temp[1024];
+	index_header_t header;
+	FILE *file;
+
+	cache->dirty = 0;
+	cache->written = (unsigned long)time(NULL);
+
+	snprintf(path, sizeof(path), "%s/" INDEX_NAME, cache->path);
+	snprintf(temp, sizeof(temp), "%s/" INDEX_NAME ".tmp", cache->path);
+
+	file = fopen(temp, "wb");
+	if (file == NULL)
+		return;
+
+	header.magic = INDEX_MAGIC;
+	header.version = INDEX_VERSION;
+	header.entry_size = sizeof(libcohost_cache_entry_t);
+	header.num_entries = cache->num_entries;
+	header.clock = cache->clock;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+		fwrite(cache->entries, sizeof(libcohost_cache_entry_t), cache->num_entries, file) != (size_t)cache->num_entries)
+	{
+		fclose(file);
+		remove(temp);
+		return;
+	}
+
+	fclose(file);
+
+	/* replace the old index in one step */
+	rename(temp, path);
+}
+
+/* open or create cache directory, bodies are evicted lru first beyond max_bytes */
+libcohost_cache_t *libcohost_cache_open(const char *path, unsigned long max_bytes, unsigned long fresh_seconds)
+{
+	libcohost_cache_t *cache;
+	size_t len;
+
+	if (path == NULL)
+		return NULL;
+
+	if (mkdir(path, 0755) != 0 && errno != EEXIST)
+		return NULL;
+
+	cache = calloc(1, sizeof(libcohost_cache_t));
+	if (cache == NULL)
+		return NULL;
+
+	len = strlen(path);
+	cache->path = malloc(len + 1);
+	if (cache->path == NULL)
+	{
+		free(cache);
+		return NULL;
+	}
+	memcpy(cache->path, path, len + 1);
+
+	cache->max_bytes = max_bytes;
+	cache->fresh_seconds = fresh_seconds;
+
+	cache_index_read(cache);
+
+	return cache;
+}
+
+/* write out the index and free the cache */
+void libcohost_cache_close(libcohost_cache_t *cache)
+{
+	if (cache == NULL)
+		return;
+
+	if (cache->dirty)
+		cache_index_write(cache);
+
+	free(cache->slots);
+	free(cache->keys);
+	free(cache->entries);
+	free(cache->path);
+	free(cache);
+}
+
+/* copy out the cache counters */
+void libcohost_cache_stats(libcohost_cache_t *cache, libcohost_cache_stats_t *stats)
+{
+	memcpy(stats, &cache->stats, sizeof(libcohost_cache_stats_t));
+}
+
+/* find entry by key, the pointer is valid until the next store */
+libcohost_cache_entry_t *libcohost_cache_find(libcohost_cache_t *cache, uint64_t key)
+{
+	int index = cache_index_of(cache, key);
+
+	if (index < 0)
+		return NULL;
+
+	return &cache->entries[index];
+}
+
+/* read entry body into buffer and mark it as recently used */
+int libcohost_cache_read(libcohost_cache_t *cache, libcohost_cache_entry_t *entry, libcohost_buffer_t *body)
+{
+	char path[1024];
+	FILE *file;
+	size_t got = 0;
+
+	cache_path(cache, path, sizeof(path), entry->key);
+
+	libcohost_buffer_reset(body);
+
+	file = fopen(path, "rb");
+	if (file != NULL)
+	{
+		if (libcohost_buffer_reserve(body, entry->size) == LIBCOHOST_RESULT_OK)
+			got = fread(body->data, 1, entry->size, file);
+		fclose(file);
+	}
+
+	/* a short read means the file is not what the index thinks it is */
+	if (file == NULL || got != entry->size)
+	{
+		libcohost_buffer_reset(body);
+		cache_remove(cache, (int)(entry - cache->entries));
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	body->len = got;
+	body->data[got] = '\0';
+	entry->used = ++cache->clock;
+	cache->dirty = 1;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* store response body with its validators, evicting old entries as needed */
+int libcohost_cache_store(libcohost_cache_t *cache, uint64_t key, const char *etag, const char *last_modified, unsigned long expires, const void *data, size_t len)
+{
+	libcohost_cache_entry_t *entry;
+	char path[1024];
+	FILE *file;
+	int index;
+
+	/* never let one response flush the whole cache */
+	if (len > cache->max_bytes / 2)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	/* replace any older copy */
+	index = cache_index_of(cache, key);
+	if (index >= 0)
+		cache_remove(cache, index);
+
+	cache_evict(cache, len);
+
+	if (cache_grow(cache) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	/* write body */
+	cache_path(cache, path, sizeof(path), key);
+	file = fopen(path, "wb");
+	if (file == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	if (fwrite(data, 1, len, file) != len)
+	{
+		fclose(file);
+		remove(path);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+	fclose(file);
+
+	/* add entry */
+	entry = &cache->entries[cache->num_entries];
+	memset(entry, 0, sizeof(libcohost_cache_entry_t));
+	entry->key = key;
+	entry->size = len;
+	entry->expires = expires;
+	entry->used = ++cache->clock;
+	if (etag)
+		strncpy(entry->etag, etag, sizeof(entry->etag) - 1);
+	if (last_modified)
+		strncpy(entry->last_modified, last_modified, sizeof(entry->last_modified) - 1);
+
+	cache->keys[cache->num_entries] = key;
+	cache->slots[cache_slot(cache, key)] = cache->num_entries;
+	cache->num_entries++;
+
+	cache->stats.bytes += len;
+	cache->stats.stores++;
+	cache->dirty = 1;
+
+	/* a crash only forgets the last few stores, their files are overwritten when stored again */
+	if ((unsigned long)time(NULL) - cache->written >= INDEX_INTERVAL)
+		cache_index_write(cache);
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* drop the entry of key and its body, if there is one */
+void libcohost_cache_remove(libcohost_cache_t *cache, uint64_t key)
+{
+	int index = cache_index_of(cache, key);
+
+	if (index < 0)
+		return;
+
+	cache_remove(cache, index);
+}
@@ -0,0 +1,119 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_CACHE_H_
+#define _LIBCOHOST_CACHE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+
+/* longest validator string kept per entry */
+#ifndef LIBCOHOST_CACHE_VALIDATOR_LEN
+#define LIBCOHOST_CACHE_VALIDATOR_LEN (128)
+#endif
+
+/* cache entry, the body itself lives in its own file */
+typedef struct libcohost_cache_entry_t {
+	uint64_t key;
+	unsigned long size;
+	unsigned long expires;
+	unsigned long used;
+	char etag[LIBCOHOST_CACHE_VALIDATOR_LEN];
+	char last_modified[LIBCOHOST_CACHE_VALIDATOR_LEN];
+} libcohost_cache_entry_t;
+
+/* cache counters */
+typedef struct libcohost_cache_stats_t {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long revalidated;
+	unsigned long stores;
+	unsigned long evictions;
+	unsigned long bytes;
+} libcohost_cache_stats_t;
+
+/* on-disk http cache */
+typedef struct libcohost_cache_t {
+	char *path;
+	unsigned long max_bytes;
+	unsigned long fresh_seconds;
+	unsigned long clock;
+	unsigned long written;
+	int dirty;
+	uint64_t *keys;
+	libcohost_cache_entry_t *entries;
+	int num_entries;
+	int max_entries;
+	int *slots;
+	int num_slots;
+	libcohost_cache_stats_t stats;
+} libcohost_cache_t;
+
+/* open or create cache directory, bodies are evicted lru first beyond max_bytes */
+/* responses without an explicit max-age are served without revalidation for fresh_seconds */
+/* returns NULL on failure */
+libcohost_cache_t *libcohost_cache_open(const char *path, unsigned long max_bytes, unsigned long fresh_seconds);
+
+/* write out the index and free the cache */
+void libcohost_cache_close(libcohost_cache_t *cache);
+
+/* copy out the cache counters */
+void libcohost_cache_stats(libcohost_cache_t *cache, libcohost_cache_stats_t *stats);
+
+/* find entry by key, the pointer is valid until the next store */
+/* returns NULL on miss */
+libcohost_cache_entry_t *libcohost_cache_find(libcohost_cache_t *cache, uint64_t key);
+
+/* read entry body into buffer and mark it as recently used */
+/* drops the entry and returns LIBCOHOST_RESULT_GENERAL_FAIL if the file is gone or damaged */
+int libcohost_cache_read(libcohost_cache_t *cache, libcohost_cache_entry_t *entry, libcohost_buffer_t *body);
+
+/* store response body with its validators, evicting old entries as needed */
+/* the index is written out every few seconds at most, and on close */
+int libcohost_cache_store(libcohost_cache_t *cache, uint64_t key, const char *etag, const char *last_modified, unsigned long expires, const void *data, size_t len);
+
+/* drop the entry of key and its body, if there is one */
+void libcohost_cache_remove(libcohost_cache_t *cache, uint64_t key);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_CACHE_H_ */
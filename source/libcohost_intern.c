@@ -0,0 +1,227 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "libcohost_intern.h"
+#include "libcohost_arena.h"
+
+/* id to string entries are allocated in chunks that never move */
+#define CHUNK_SIZE (4096)
+#define MAX_CHUNKS (1024)
+
+/* initial hash slot count, power of two */
+#define SLOTS_MIN (1024)
+
+/* interned string */
+typedef struct intern_entry_t {
+	const char *string;
+	uint32_t len;
+	uint32_t hash;
+} intern_entry_t;
+
+/* writers are serialized, readers only go through the chunks */
+static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+static intern_entry_t *chunks[MAX_CHUNKS];
+static uint32_t num_entries;
+static uint32_t *slots;
+static uint32_t num_slots;
+static libcohost_arena_t arena;
+static libcohost_intern_stats_t stats;
+
+/* get the entry of an id */
+static intern_entry_t *intern_entry(libcohost_intern_t id)
+{
+	return &chunks[id / CHUNK_SIZE][id % CHUNK_SIZE];
+}
+
+/* append an entry, returns its id or 0 on failure */
+static libcohost_intern_t intern_add(const char *s, uint32_t len, uint32_t hash)
+{
+	intern_entry_t *entry;
+	char *copy;
+
+	if (num_entries >= CHUNK_SIZE * MAX_CHUNKS)
+		return 0;
+
+	if (chunks[num_entries / CHUNK_SIZE] == NULL)
+	{
+		chunks[num_entries / CHUNK_SIZE] = malloc(CHUNK_SIZE * sizeof(intern_entry_t));
+		if (chunks[num_entries / CHUNK_SIZE] == NULL)
+			return 0;
+	}
+
+	copy = libcohost_arena_alloc(&arena, len + 1);
+	if (copy == NULL)
+		return 0;
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+
+	entry = intern_entry(num_entries);
+	entry->string = copy;
+	entry->len = len;
+	entry->hash = hash;
+
+	/* what the copies really take once the arena has rounded them up */
+	stats.strings++;
+	stats.bytes = arena.stats.bytes;
+
+	return num_entries++;
+}
+
+/* resize the slot array and reinsert every id */
+static int intern_rehash(uint32_t size)
+{
+	uint32_t *grown;
+	uint32_t i, slot;
+
+	grown = calloc(size, sizeof(uint32_t));
+	if (grown == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	/* id 0 is never hashed */
+	for (i = 1; i < num_entries; i++)
+	{
+		slot = intern_entry(i)->hash & (size - 1);
+		while (grown[slot])
+			slot = (slot + 1) & (size - 1);
+		grown[slot] = i;
+	}
+
+	free(slots);
+	slots = grown;
+	num_slots = size;
+	stats.slots = size;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* get the id of a string, adding it on first sight */
+libcohost_intern_t libcohost_intern(const char *s, size_t len)
+{
+	libcohost_intern_t id = 0;
+	intern_entry_t *entry;
+	uint32_t hash, slot;
+
+	if (s == NULL || len == 0 || len > UINT32_MAX)
+		return 0;
+
+	hash = (uint32_t)libcohost_hash(s, len, LIBCOHOST_HASH_SEED);
+
+	pthread_mutex_lock(&intern_lock);
+
+	stats.lookups++;
+	stats.bytes_requested += len + 1;
+
+	/* first use, id 0 is the empty string */
+	if (num_entries == 0)
+	{
+		libcohost_arena_init(&arena, 0);
+		intern_add("", 0, 0);
+		if (num_entries == 0)
+			goto done;
+	}
+
+	/* keep the load factor under a half */
+	if ((num_entries + 1) * 2 > num_slots && intern_rehash(num_slots ? num_slots * 2 : SLOTS_MIN) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	/* linear probe */
+	for (slot = hash & (num_slots - 1); slots[slot]; slot = (slot + 1) & (num_slots - 1))
+	{
+		entry = intern_entry(slots[slot]);
+		if (entry->hash == hash && entry->len == len && memcmp(entry->string, s, len) == 0)
+		{
+			id = slots[slot];
+			goto done;
+		}
+	}
+
+	id = intern_add(s, (uint32_t)len, hash);
+	if (id)
+		slots[slot] = id;
+
+done:
+	pthread_mutex_unlock(&intern_lock);
+
+	return id;
+}
+
+/* get the string of an id, safe from any thread that received the id */
+const char *libcohost_intern_string(libcohost_intern_t id)
+{
+	if (id == 0)
+		return "";
+
+	return intern_entry(id)->string;
+}
+
+/* copy out the interning counters */
+void libcohost_intern_stats(libcohost_intern_stats_t *out)
+{
+	pthread_mutex_lock(&intern_lock);
+	memcpy(out, &stats, sizeof(libcohost_intern_stats_t));
+	pthread_mutex_unlock(&intern_lock);
+}
+
+/* release every interned string, done by libcohost_quit() */
+void libcohost_intern_free(void)
+{
+	int i;
+
+	pthread_mutex_lock(&intern_lock);
+
+	for (i = 0; i < MAX_CHUNKS; i++)
+	{
+		free(chunks[i]);
+		chunks[i] = NULL;
+	}
+
+	free(slots);
+	slots = NULL;
+	num_slots = 0;
+	num_entries = 0;
+
+	libcohost_arena_free(&arena);
+	memset(&stats, 0, sizeof(libcohost_intern_stats_t));
+
+	pthread_mutex_unlock(&intern_lock);
+}
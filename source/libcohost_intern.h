@@ -0,0 +1,76 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_INTERN_H_
+#define _LIBCOHOST_INTERN_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+
+/* id of an interned string, 0 is the empty string */
+typedef uint32_t libcohost_intern_t;
+
+/* interning counters */
+typedef struct libcohost_intern_stats_t {
+	unsigned long lookups;
+	unsigned long strings;
+	unsigned long bytes; /* stored once, arena rounding included */
+	unsigned long bytes_requested; /* as if every lookup kept a copy */
+	unsigned long slots;
+} libcohost_intern_stats_t;
+
+/* get the id of a string, adding it on first sight */
+/* ids stay valid until libcohost_quit(), returns 0 on failure */
+libcohost_intern_t libcohost_intern(const char *s, size_t len);
+
+/* get the string of an id, safe from any thread that received the id */
+const char *libcohost_intern_string(libcohost_intern_t id);
+
+/* copy out the interning counters */
+void libcohost_intern_stats(libcohost_intern_stats_t *stats);
+
+/* release every interned string, done by libcohost_quit() */
+void libcohost_intern_free(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_INTERN_H_ */
@@ -0,0 +1,886 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "thirdparty/cJSON.h"
+
+#include "libcohost_json.h"
+#include "libcohost_arena.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCAN_X86
+#endif
+
+/* finds the next byte that can change the splitter state */
+typedef size_t (*scan_func_t)(const char *data, size_t len, int in_string);
+
+/* is c a byte the splitter has to look at */
+static int scan_special(char c, int in_string)
+{
+	if (c == '"' || c == '\\')
+		return 1;
+	if (in_string)
+		return 0;
+	return c == '{' || c == '}' || c == '[' || c == ']';
+}
+
+/* portable version, one byte at a time */
+static size_t scan_scalar(const char *data, size_t len, int in_string)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		if (scan_special(data[i], in_string))
+			return i;
+
+	return len;
+}
+
+#ifdef SCAN_X86
+
+/* 16 bytes at a time */
+__attribute__((target("sse2")))
+static size_t scan_sse2(const char *data, size_t len, int in_string)
+{
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i brace_open = _mm_set1_epi8('{');
+	const __m128i brace_close = _mm_set1_epi8('}');
+	const __m128i bracket_open = _mm_set1_epi8('[');
+	const __m128i bracket_close = _mm_set1_epi8(']');
+	__m128i block, hits;
+	unsigned int mask;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16)
+	{
+		block = _mm_loadu_si128((const __m128i *)(data + i));
+		hits = _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash));
+
+		/* nesting only matters outside of strings */
+		if (!in_string)
+		{
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, brace_open));
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, brace_close));
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, bracket_open));
+			hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, bracket_close));
+		}
+
+		mask = (unsigned int)_mm_movemask_epi8(hits);
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+
+	return i + scan_scalar(data + i, len - i, in_string);
+}
+
+/* 32 bytes at a time */
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *data, size_t len, int in_string)
+{
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i brace_open = _mm256_set1_epi8('{');
+	const __m256i brace_close = _mm256_set1_epi8('}');
+	const __m256i bracket_open = _mm256_set1_epi8('[');
+	const __m256i bracket_close = _mm256_set1_epi8(']');
+	__m256i block, hits;
+	unsigned int mask;
+	size_t i;
+
+	for (i = 0; i + 32 <= len; i += 32)
+	{
+		block = _mm256_loadu_si256((const __m256i *)(data + i));
+		hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, quote), _mm256_cmpeq_epi8(block, backslash));
+
+		/* nesting only matters outside of strings */
+		if (!in_string)
+		{
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, brace_open));
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, brace_close));
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, bracket_open));
+			hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, bracket_close));
+		}
+
+		mask = (unsigned int)_mm256_movemask_epi8(hits);
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+
+	return i + scan_sse2(data + i, len - i, in_string);
+}
+
+#endif
+
+/* scanner picked by libcohost_json_scan_set() */
+static scan_func_t scan = scan_scalar;
+
+/* pick the structural scanner, level is clamped to what the cpu supports */
+int libcohost_json_scan_set(int level)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+
+	if (level >= LIBCOHOST_JSON_SCAN_AVX2 && __builtin_cpu_supports("avx2"))
+	{
+		scan = scan_avx2;
+		return LIBCOHOST_JSON_SCAN_AVX2;
+	}
+
+	if (level >= LIBCOHOST_JSON_SCAN_SSE2 && __builtin_cpu_supports("sse2"))
+	{
+		scan = scan_sse2;
+		return LIBCOHOST_JSON_SCAN_SSE2;
+	}
+#endif
+
+	(void)level;
+	scan = scan_scalar;
+	return LIBCOHOST_JSON_SCAN_SCALAR;
+}
+
+/* parse one complete element and hand it to the callback */
+static void stream_emit(libcohost_json_stream_t *stream, const char *data, size_t len)
+{
+	libcohost_arena_t *arena = libcohost_arena_current();
+	cJSON *json;
+
+	json = cJSON_ParseWithLength(data, len);
+	if (json == NULL)
+	{
+		stream->num_errors++;
+	}
+	else
+	{
+		stream->num_items++;
+
+		if (stream->callback)
+			stream->callback(json, stream->user);
+
+		/* an arena tree is dropped wholesale below */
+		if (arena == NULL || arena->heap)
+			cJSON_Delete(json);
+	}
+
+	/* elements are independent, so the arena is rewound for the next one */
+	if (arena)
+		libcohost_arena_reset(arena);
+}
+
+/* setup stream to emit the objects of the array under key in the top level object */
+void libcohost_json_stream_init(libcohost_json_stream_t *stream, const char *key, libcohost_json_item_callback_t callback, void *user)
+{
+	memset(stream, 0, sizeof(libcohost_json_stream_t));
+
+	if (key)
+		strncpy(stream->key, key, sizeof(stream->key) - 1);
+
+	stream->callback = callback;
+	stream->user = user;
+}
+
+/* feed the next chunk of the document, elements are emitted as soon as they close */
+int libcohost_json_stream_feed(libcohost_json_stream_t *stream, const void *data, size_t len)
+{
+	const char *bytes = data;
+	size_t i, next, start = 0;
+	char c;
+
+	stream->bytes += len;
+
+	for (i = 0; i < len; i++)
+	{
+		/* the byte after a backslash never ends a string */
+		if (stream->escape)
+		{
+			stream->escape = 0;
+			continue;
+		}
+
+		/* skip ahead to the next byte that can change state */
+		next = i + scan(bytes + i, len - i, stream->in_string);
+
+		/* keys of the top level object are remembered */
+		if (stream->in_string && stream->depth == 1)
+		{
+			for (; i < next && stream->last_key_len < LIBCOHOST_JSON_KEY_LEN - 1; i++)
+				stream->last_key[stream->last_key_len++] = bytes[i];
+		}
+
+		i = next;
+		if (i >= len)
+			break;
+
+		c = bytes[i];
+
+		/* inside a string only the closing quote matters */
+		if (stream->in_string)
+		{
+			if (c == '\\')
+				stream->escape = 1;
+			else
+				stream->in_string = 0;
+
+			continue;
+		}
+
+		switch (c)
+		{
+			case '"':
+				stream->in_string = 1;
+				/* the last string at depth 1 before a '[' is that array's key */
+				if (stream->depth == 1)
+					stream->last_key_len = 0;
+				break;
+
+			case '[':
+				stream->depth++;
+				if (stream->array_depth)
+					break;
+
+				if (stream->key[0] == '\0' && stream->depth == 1)
+				{
+					stream->array_depth = 1;
+				}
+				else if (stream->depth == 2)
+				{
+					stream->last_key[stream->last_key_len] = '\0';
+					if (stream->key[0] && strcmp(stream->key, stream->last_key) == 0)
+						stream->array_depth = 2;
+				}
+				break;
+
+			case '{':
+				stream->depth++;
+				if (stream->array_depth && stream->depth == stream->array_depth + 1)
+				{
+					stream->capturing = 1;
+					stream->item_offset = stream->bytes - len + i;
+					start = i;
+				}
+				break;
+
+			case '}':
+				if (stream->capturing && stream->depth == stream->array_depth + 1)
+				{
+					stream->capturing = 0;
+
+					/* parse in place if the element sits inside this chunk */
+					if (stream->span_callback)
+					{
+						stream->num_items++;
+						stream->span_callback(stream->item_offset, stream->bytes - len + i + 1 - stream->item_offset, stream->user);
+					}
+					else if (stream->item.len == 0)
+					{
+						stream_emit(stream, bytes + start, i + 1 - start);
+					}
+					else
+					{
+						if (libcohost_buffer_append(&stream->item, bytes, i + 1) != LIBCOHOST_RESULT_OK)
+							return LIBCOHOST_RESULT_ALLOC_FAIL;
+						stream_emit(stream, stream->item.data, stream->item.len);
+						libcohost_buffer_reset(&stream->item);
+					}
+				}
+				stream->depth--;
+				break;
+
+			case ']':
+				if (stream->depth == stream->array_depth)
+					stream->array_depth = -1;
+				stream->depth--;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	/* carry the unfinished element over to the next chunk */
+	if (stream->capturing && stream->span_callback == NULL)
+	{
+		if (stream->item.len == 0)
+			i = start;
+		else
+			i = 0;
+
+		if (libcohost_buffer_append(&stream->item, bytes + i, len - i) != LIBCOHOST_RESULT_OK)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* release stream scratch memory */
+void libcohost_json_stream_free(libcohost_json_stream_t *stream)
+{
+	libcohost_buffer_free(&stream->item);
+}
+
+/* end of the value starting at data[i] */
+static size_t json_skip_value(const char *data, size_t i, size_t len)
+{
+	int depth = 0, in_string = 0;
+	char c;
+
+	/* primitives end at the next delimiter */
+	if (data[i] != '"' && data[i] != '{' && data[i] != '[')
+	{
+		while (i < len && !strchr(",:}] \t\r\n", data[i]))
+			i++;
+		return i;
+	}
+
+	while (i < len)
+	{
+		i += scan(data + i, len - i, in_string);
+		if (i >= len)
+			break;
+
+		c = data[i++];
+
+		if (in_string)
+		{
+			if (c == '\\')
+			{
+				i++;
+			}
+			else
+			{
+				in_string = 0;
+				if (depth == 0)
+					return i;
+			}
+			continue;
+		}
+
+		switch (c)
+		{
+			case '"':
+				in_string = 1;
+				break;
+
+			case '{':
+			case '[':
+				depth++;
+				break;
+
+			case '}':
+			case ']':
+				if (--depth == 0)
+					return i;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	return len;
+}
+
+/* skip insignificant whitespace */
+static size_t json_skip_space(const char *data, size_t i, size_t len)
+{
+	while (i < len && (data[i] == ' ' || data[i] == '\t' || data[i] == '\r' || data[i] == '\n'))
+		i++;
+	return i;
+}
+
+/* move *pos from the object at *pos to the value of member name */
+static int json_member(const char *data, size_t *pos, size_t len, const char *name, size_t name_len)
+{
+	size_t i = *pos, key, key_len;
+
+	if (i >= len || data[i] != '{')
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	for (i++; ; i++)
+	{
+		i = json_skip_space(data, i, len);
+		if (i >= len || data[i] != '"')
+			return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+		/* keys are compared as written, escapes and all */
+		key = i + 1;
+		i = json_skip_value(data, i, len);
+		key_len = i - 1 - key;
+
+		i = json_skip_space(data, i, len);
+		if (i >= len || data[i] != ':')
+			return LIBCOHOST_RESULT_GENERAL_FAIL;
+		i = json_skip_space(data, i + 1, len);
+
+		if (key_len == name_len && memcmp(data + key, name, name_len) == 0)
+		{
+			*pos = i;
+			return LIBCOHOST_RESULT_OK;
+		}
+
+		i = json_skip_space(data, json_skip_value(data, i, len), len);
+		if (i >= len || data[i] != ',')
+			return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+}
+
+/* index callback recording the span of each element */
+static void index_span(size_t offset, size_t len, void *user)
+{
+	libcohost_json_index_t *index = user;
+	libcohost_json_span_t *grown;
+
+	if (index->num_items >= index->max_items)
+	{
+		grown = realloc(index->items, (index->max_items ? index->max_items * 2 : 64) * sizeof(libcohost_json_span_t));
+		if (grown == NULL)
+		{
+			index->failed = 1;
+			return;
+		}
+		index->items = grown;
+		index->max_items = index->max_items ? index->max_items * 2 : 64;
+	}
+
+	index->items[index->num_items].offset = (uint32_t)offset;
+	index->items[index->num_items].len = (uint32_t)len;
+	index->num_items++;
+}
+
+/* record where each object of the array under key starts and ends */
+int libcohost_json_index_build(libcohost_json_index_t *index, const char *key, libcohost_buffer_t *raw)
+{
+	libcohost_json_stream_t stream;
+
+	/* key may point into the index itself */
+	libcohost_json_stream_init(&stream, key, NULL, index);
+	stream.span_callback = index_span;
+
+	memset(index, 0, sizeof(libcohost_json_index_t));
+	memcpy(index->key, stream.key, sizeof(index->key));
+
+	if (raw->len > UINT32_MAX)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	/* take over the response buffer */
+	memcpy(&index->raw, raw, sizeof(libcohost_buffer_t));
+	memset(raw, 0, sizeof(libcohost_buffer_t));
+
+	libcohost_json_stream_feed(&stream, index->raw.data, index->raw.len);
+	libcohost_json_stream_free(&stream);
+
+	return index->failed ? LIBCOHOST_RESULT_ALLOC_FAIL : LIBCOHOST_RESULT_OK;
+}
+
+/* parse one element in full, free it with cJSON_Delete() */
+void *libcohost_json_index_item(libcohost_json_index_t *index, int item)
+{
+	if (item < 0 || item >= index->num_items)
+		return NULL;
+
+	return cJSON_ParseWithLength(index->raw.data + index->items[item].offset, index->items[item].len);
+}
+
+/* find the raw value of a dotted member path inside one element */
+int libcohost_json_index_field(libcohost_json_index_t *index, int item, const char *path, const char **value, size_t *len)
+{
+	const char *data, *dot;
+	size_t pos, end, span;
+
+	if (item < 0 || item >= index->num_items)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	data = index->raw.data + index->items[item].offset;
+	span = index->items[item].len;
+	pos = 0;
+
+	/* descend one object per path component */
+	for (;;)
+	{
+		dot = strchr(path, '.');
+		if (json_member(data, &pos, span, path, dot ? (size_t)(dot - path) : strlen(path)) != LIBCOHOST_RESULT_OK)
+			return LIBCOHOST_RESULT_GENERAL_FAIL;
+		if (dot == NULL)
+			break;
+		path = dot + 1;
+	}
+
+	end = json_skip_value(data, pos, span);
+
+	/* strings are returned without their quotes */
+	if (data[pos] == '"')
+	{
+		pos++;
+		end--;
+	}
+
+	*value = data + pos;
+	*len = end - pos;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* copy out a string member, escapes are decoded, returns the length or -1 */
+int libcohost_json_index_string(libcohost_json_index_t *index, int item, const char *path, char *out, size_t size)
+{
+	const char *value;
+	cJSON *json;
+	size_t len;
+
+	if (size == 0 || libcohost_json_index_field(index, item, path, &value, &len) != LIBCOHOST_RESULT_OK)
+		return -1;
+
+	/* only strings with escapes need a real parse */
+	if (memchr(value, '\\', len))
+	{
+		json = cJSON_ParseWithLength(value - 1, len + 2);
+		if (!cJSON_IsString(json))
+		{
+			cJSON_Delete(json);
+			return -1;
+		}
+		len = strlen(json->valuestring);
+		if (len >= size)
+			len = size - 1;
+		memcpy(out, json->valuestring, len);
+		cJSON_Delete(json);
+	}
+	else
+	{
+		if (len >= size)
+			len = size - 1;
+		memcpy(out, value, len);
+	}
+
+	out[len] = '\0';
+
+	return (int)len;
+}
+
+/* get a numeric member, 0 if missing */
+double libcohost_json_index_number(libcohost_json_index_t *index, int item, const char *path)
+{
+	const char *value;
+	size_t len;
+
+	if (libcohost_json_index_field(index, item, path, &value, &len) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	/* the response buffer is nul terminated, so strtod can't run off it */
+	return strtod(value, NULL);
+}
+
+/* release the index and the response it holds */
+void libcohost_json_index_free(libcohost_json_index_t *index)
+{
+	free(index->items);
+	libcohost_buffer_free(&index->raw);
+	memset(index, 0, sizeof(libcohost_json_index_t));
+}
+
+/* setup reader over a buffer it may modify */
+void libcohost_json_reader_init(libcohost_json_reader_t *reader, char *data, size_t len)
+{
+	reader->data = data;
+	reader->pos = 0;
+	reader->len = len;
+	reader->failed = 0;
+}
+
+/* skip whitespace and at most one separating comma */
+static void reader_separator(libcohost_json_reader_t *reader)
+{
+	reader->pos = json_skip_space(reader->data, reader->pos, reader->len);
+	if (reader->pos < reader->len && reader->data[reader->pos] == ',')
+		reader->pos = json_skip_space(reader->data, reader->pos + 1, reader->len);
+}
+
+/* get the type of the next value without consuming it */
+int libcohost_json_reader_type(libcohost_json_reader_t *reader)
+{
+	reader->pos = json_skip_space(reader->data, reader->pos, reader->len);
+	if (reader->failed || reader->pos >= reader->len)
+		return LIBCOHOST_JSON_NONE;
+
+	switch (reader->data[reader->pos])
+	{
+		case '{': return LIBCOHOST_JSON_OBJECT;
+		case '[': return LIBCOHOST_JSON_ARRAY;
+		case '"': return LIBCOHOST_JSON_STRING;
+		case 't': return LIBCOHOST_JSON_TRUE;
+		case 'f': return LIBCOHOST_JSON_FALSE;
+		case 'n': return LIBCOHOST_JSON_NULL;
+		default: return LIBCOHOST_JSON_NUMBER;
+	}
+}
+
+/* step into the object or array that comes next */
+int libcohost_json_reader_enter(libcohost_json_reader_t *reader)
+{
+	int type = libcohost_json_reader_type(reader);
+
+	if (type != LIBCOHOST_JSON_OBJECT && type != LIBCOHOST_JSON_ARRAY)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	reader->pos++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* write a code point as utf-8, returns the byte count */
+static size_t utf8_encode(char *out, unsigned long c)
+{
+	if (c < 0x80)
+	{
+		out[0] = (char)c;
+		return 1;
+	}
+	if (c < 0x800)
+	{
+		out[0] = (char)(0xC0 | (c >> 6));
+		out[1] = (char)(0x80 | (c & 0x3F));
+		return 2;
+	}
+	if (c < 0x10000)
+	{
+		out[0] = (char)(0xE0 | (c >> 12));
+		out[1] = (char)(0x80 | ((c >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (c & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (c >> 18));
+	out[1] = (char)(0x80 | ((c >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((c >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (c & 0x3F));
+	return 4;
+}
+
+/* parse four hex digits, returns -1 if they aren't */
+static long hex4(const char *s)
+{
+	long c = 0;
+	int i;
+
+	for (i = 0; i < 4; i++)
+	{
+		c <<= 4;
+		if (s[i] >= '0' && s[i] <= '9') c |= s[i] - '0';
+		else if (s[i] >= 'a' && s[i] <= 'f') c |= s[i] - 'a' + 10;
+		else if (s[i] >= 'A' && s[i] <= 'F') c |= s[i] - 'A' + 10;
+		else return -1;
+	}
+
+	return c;
+}
+
+/* decode escapes of the string body at data[i..end) in place */
+/* decoded text is never longer than its escaped form */
+static size_t unescape(char *data, size_t i, size_t end)
+{
+	size_t out = i;
+	long c, low;
+
+	while (i < end)
+	{
+		if (data[i] != '\\')
+		{
+			data[out++] = data[i++];
+			continue;
+		}
+
+		if (i + 1 >= end)
+			break;
+
+		switch (data[i + 1])
+		{
+			case 'b': data[out++] = '\b'; i += 2; break;
+			case 'f': data[out++] = '\f'; i += 2; break;
+			case 'n': data[out++] = '\n'; i += 2; break;
+			case 'r': data[out++] = '\r'; i += 2; break;
+			case 't': data[out++] = '\t'; i += 2; break;
+
+			case 'u':
+				c = i + 6 <= end ? hex4(data + i + 2) : -1;
+				if (c < 0)
+					return out;
+				i += 6;
+
+				/* join surrogate pairs */
+				if (c >= 0xD800 && c <= 0xDBFF && i + 6 <= end && data[i] == '\\' && data[i + 1] == 'u')
+				{
+					low = hex4(data + i + 2);
+					if (low >= 0xDC00 && low <= 0xDFFF)
+					{
+						c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+						i += 6;
+					}
+				}
+
+				out += utf8_encode(data + out, (unsigned long)c);
+				break;
+
+			default:
+				/* quote, backslash and slash stand for themselves */
+				data[out++] = data[i + 1];
+				i += 2;
+				break;
+		}
+	}
+
+	return out;
+}
+
+/* read a string in situ, it is unescaped and nul terminated inside the buffer */
+int libcohost_json_reader_string(libcohost_json_reader_t *reader, char **s, size_t *len)
+{
+	size_t start, end;
+
+	if (libcohost_json_reader_type(reader) != LIBCOHOST_JSON_STRING)
+	{
+		libcohost_json_reader_skip(reader);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	start = reader->pos + 1;
+	reader->pos = json_skip_value(reader->data, reader->pos, reader->len);
+
+	/* an unterminated string runs off the end of the data */
+	if (reader->pos <= start || reader->data[reader->pos - 1] != '"')
+	{
+		reader->failed = 1;
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+	end = reader->pos - 1;
+
+	/* strings without escapes are used right where they are */
+	if (memchr(reader->data + start, '\\', end - start))
+		end = unescape(reader->data, start, end);
+
+	/* the closing quote, or what's left of the escapes, makes room for the nul */
+	reader->data[end] = '\0';
+
+	*s = reader->data + start;
+	*len = end - start;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* read a number, 0 for anything else */
+double libcohost_json_reader_number(libcohost_json_reader_t *reader)
+{
+	double value;
+
+	if (libcohost_json_reader_type(reader) != LIBCOHOST_JSON_NUMBER)
+	{
+		libcohost_json_reader_skip(reader);
+		return 0;
+	}
+
+	value = strtod(reader->data + reader->pos, NULL);
+	libcohost_json_reader_skip(reader);
+
+	return value;
+}
+
+/* read a boolean, anything but true is false */
+int libcohost_json_reader_bool(libcohost_json_reader_t *reader)
+{
+	int type = libcohost_json_reader_type(reader);
+
+	libcohost_json_reader_skip(reader);
+
+	return type == LIBCOHOST_JSON_TRUE;
+}
+
+/* skip the next value */
+void libcohost_json_reader_skip(libcohost_json_reader_t *reader)
+{
+	if (libcohost_json_reader_type(reader) == LIBCOHOST_JSON_NONE)
+		return;
+
+	reader->pos = json_skip_value(reader->data, reader->pos, reader->len);
+}
+
+/* move to the next member of the current object */
+/* returns 0 after consuming the closing brace */
+int libcohost_json_reader_member(libcohost_json_reader_t *reader, char **key, size_t *len)
+{
+	reader_separator(reader);
+
+	if (reader->failed || reader->pos >= reader->len || reader->data[reader->pos] == '}')
+	{
+		reader->pos++;
+		return 0;
+	}
+
+	if (libcohost_json_reader_string(reader, key, len) != LIBCOHOST_RESULT_OK)
+	{
+		reader->failed = 1;
+		return 0;
+	}
+
+	reader->pos = json_skip_space(reader->data, reader->pos, reader->len);
+	if (reader->pos >= reader->len || reader->data[reader->pos] != ':')
+	{
+		reader->failed = 1;
+		return 0;
+	}
+	reader->pos++;
+
+	return 1;
+}
+
+/* move to the next element of the current array */
+/* returns 0 after consuming the closing bracket */
+int libcohost_json_reader_element(libcohost_json_reader_t *reader)
+{
+	reader_separator(reader);
+
+	if (reader->failed || reader->pos >= reader->len || reader->data[reader->pos] == ']')
+	{
+		reader->pos++;
+		return 0;
+	}
+
+	return 1;
+}
@@ -0,0 +1,199 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_JSON_H_
+#define _LIBCOHOST_JSON_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+
+/* longest member key the stream can match on */
+#ifndef LIBCOHOST_JSON_KEY_LEN
+#define LIBCOHOST_JSON_KEY_LEN (64)
+#endif
+
+/* structural scanner implementations */
+enum {
+	LIBCOHOST_JSON_SCAN_SCALAR,
+	LIBCOHOST_JSON_SCAN_SSE2,
+	LIBCOHOST_JSON_SCAN_AVX2
+};
+
+/* value types seen by the reader */
+enum {
+	LIBCOHOST_JSON_NONE,
+	LIBCOHOST_JSON_OBJECT,
+	LIBCOHOST_JSON_ARRAY,
+	LIBCOHOST_JSON_STRING,
+	LIBCOHOST_JSON_NUMBER,
+	LIBCOHOST_JSON_TRUE,
+	LIBCOHOST_JSON_FALSE,
+	LIBCOHOST_JSON_NULL
+};
+
+/* called with each parsed array element, the tree is freed when it returns */
+typedef void (*libcohost_json_item_callback_t)(void *json, void *user);
+
+/* called with the byte range of each array element instead of parsing it */
+typedef void (*libcohost_json_span_callback_t)(size_t offset, size_t len, void *user);
+
+/* incremental splitter that parses one array element at a time */
+typedef struct libcohost_json_stream_t {
+	char key[LIBCOHOST_JSON_KEY_LEN];
+	char last_key[LIBCOHOST_JSON_KEY_LEN];
+	int last_key_len;
+	int depth;
+	int array_depth;
+	int in_string;
+	int escape;
+	int capturing;
+	libcohost_buffer_t item;
+	libcohost_json_item_callback_t callback;
+	libcohost_json_span_callback_t span_callback;
+	size_t item_offset;
+	void *user;
+	unsigned long num_items;
+	unsigned long num_errors;
+	unsigned long bytes;
+} libcohost_json_stream_t;
+
+/* setup stream to emit the objects of the array under key in the top level object */
+/* with key NULL the top level value itself must be the array */
+void libcohost_json_stream_init(libcohost_json_stream_t *stream, const char *key, libcohost_json_item_callback_t callback, void *user);
+
+/* feed the next chunk of the document, elements are emitted as soon as they close */
+/* returns LIBCOHOST_RESULT_ALLOC_FAIL on failure */
+int libcohost_json_stream_feed(libcohost_json_stream_t *stream, const void *data, size_t len);
+
+/* release stream scratch memory */
+void libcohost_json_stream_free(libcohost_json_stream_t *stream);
+
+/* byte range of one element in the raw response */
+typedef struct libcohost_json_span_t {
+	uint32_t offset;
+	uint32_t len;
+} libcohost_json_span_t;
+
+/* lazy view of a response, elements are only parsed when asked for */
+typedef struct libcohost_json_index_t {
+	char key[LIBCOHOST_JSON_KEY_LEN];
+	libcohost_buffer_t raw;
+	libcohost_json_span_t *items;
+	int num_items;
+	int max_items;
+	int failed;
+} libcohost_json_index_t;
+
+/* record where each object of the array under key starts and ends */
+/* the index takes over the contents of raw and leaves it empty */
+int libcohost_json_index_build(libcohost_json_index_t *index, const char *key, libcohost_buffer_t *raw);
+
+/* parse one element in full, free it with cJSON_Delete() */
+/* returns NULL on failure */
+void *libcohost_json_index_item(libcohost_json_index_t *index, int item);
+
+/* find the raw value of a dotted member path like "postingProject.handle" */
+/* strings are returned without quotes and with escapes left as they are */
+int libcohost_json_index_field(libcohost_json_index_t *index, int item, const char *path, const char **value, size_t *len);
+
+/* copy out a string member, escapes are decoded, returns the length or -1 */
+int libcohost_json_index_string(libcohost_json_index_t *index, int item, const char *path, char *out, size_t size);
+
+/* get a numeric member, 0 if missing */
+double libcohost_json_index_number(libcohost_json_index_t *index, int item, const char *path);
+
+/* release the index and the response it holds */
+void libcohost_json_index_free(libcohost_json_index_t *index);
+
+/* pull reader that decodes strings inside the buffer it reads */
+typedef struct libcohost_json_reader_t {
+	char *data;
+	size_t pos;
+	size_t len;
+	int failed;
+} libcohost_json_reader_t;
+
+/* setup reader over a buffer it may modify */
+/* everything behind the read position is rewritten, so each byte is read once */
+void libcohost_json_reader_init(libcohost_json_reader_t *reader, char *data, size_t len);
+
+/* get the type of the next value without consuming it */
+int libcohost_json_reader_type(libcohost_json_reader_t *reader);
+
+/* step into the object or array that comes next */
+int libcohost_json_reader_enter(libcohost_json_reader_t *reader);
+
+/* move to the next member of the current object */
+/* returns 0 after consuming the closing brace */
+int libcohost_json_reader_member(libcohost_json_reader_t *reader, char **key, size_t *len);
+
+/* move to the next element of the current array */
+/* returns 0 after consuming the closing bracket */
+int libcohost_json_reader_element(libcohost_json_reader_t *reader);
+
+/* read a string in situ, it is unescaped and nul terminated inside the buffer */
+int libcohost_json_reader_string(libcohost_json_reader_t *reader, char **s, size_t *len);
+
+/* read a number, 0 for anything else */
+double libcohost_json_reader_number(libcohost_json_reader_t *reader);
+
+/* read a boolean, anything but true is false */
+int libcohost_json_reader_bool(libcohost_json_reader_t *reader);
+
+/* skip the next value */
+void libcohost_json_reader_skip(libcohost_json_reader_t *reader);
+
+/* keep the raw response in request->index and only index its elements */
+/* request->body is left empty, the index holds the response instead */
+int libcohost_request_index_set(libcohost_request_t *request, const char *key);
+
+/* pick the structural scanner, level is clamped to what the cpu supports */
+/* libcohost_init() picks the widest one, returns the level in use */
+int libcohost_json_scan_set(int level);
+
+/* parse the response incrementally, emitting each object of the array under key */
+/* the callback runs on the thread doing network i/o and the body is not kept */
+int libcohost_request_stream_set(libcohost_request_t *request, const char *key, libcohost_json_item_callback_t callback, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_JSON_H_ */
@@ -0,0 +1,231 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libcohost_limit.h"
+
+/* retry delays double from here up to the cap */
+#define LIMIT_BACKOFF_BASE (500000)
+#define LIMIT_BACKOFF_MAX (30000000)
+
+/* throttling within this long of the last decrease is the same episode */
+#define LIMIT_DECREASE_HOLD (1000000)
+
+/* xorshift, jitter doesn't need anything better */
+static uint32_t limit_random(libcohost_limit_t *limit)
+{
+	uint32_t x = limit->seed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	limit->seed = x;
+
+	return x;
+}
+
+/* add the tokens accumulated since the last refill */
+static void limit_refill(libcohost_limit_t *limit, uint64_t now)
+{
+	if (now <= limit->refilled)
+		return;
+
+	limit->tokens += (double)(now - limit->refilled) * limit->rate / 1000000.0;
+	if (limit->tokens > limit->burst)
+		limit->tokens = limit->burst;
+	limit->refilled = now;
+}
+
+/* create a limiter starting rate requests per second, up to burst at once */
+libcohost_limit_t *libcohost_limit_new(double rate, int burst, int max_window)
+{
+	libcohost_limit_t *limit;
+
+	limit = calloc(1, sizeof(libcohost_limit_t));
+	if (limit == NULL)
+		return NULL;
+
+	limit->rate = rate;
+	limit->burst = burst > 0 ? burst : 1;
+	limit->tokens = limit->burst;
+	limit->refilled = libcohost_limit_now();
+	limit->max_window = max_window > 0 ? max_window : 1;
+	limit->window = limit->max_window;
+	limit->seed = (uint32_t)limit->refilled | 1;
+	limit->stats.window = limit->window;
+
+	return limit;
+}
+
+/* free a limiter */
+void libcohost_limit_free(libcohost_limit_t *limit)
+{
+	free(limit);
+}
+
+/* monotonic clock the limiter runs on */
+uint64_t libcohost_limit_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* take a token and a window slot for a request queued since queued */
+int libcohost_limit_acquire(libcohost_limit_t *limit, uint64_t queued, uint64_t now)
+{
+	unsigned long wait;
+
+	if (now < limit->paused_until || limit->active >= (int)limit->window)
+		return 0;
+
+	if (limit->rate > 0)
+	{
+		limit_refill(limit, now);
+		if (limit->tokens < 1.0)
+			return 0;
+		limit->tokens -= 1.0;
+	}
+
+	limit->active++;
+
+	wait = queued && now > queued ? (unsigned long)(now - queued) : 0;
+	limit->stats.started++;
+	limit->stats.wait_us += wait;
+	if (wait > limit->stats.wait_max_us)
+		limit->stats.wait_max_us = wait;
+	limit->stats.active = limit->active;
+
+	return 1;
+}
+
+/* give back the window slot of a finished request */
+void libcohost_limit_release(libcohost_limit_t *limit, long status, unsigned long retry_after, uint64_t now)
+{
+	if (limit->active > 0)
+		limit->active--;
+	limit->stats.active = limit->active;
+
+	if (status == 0)
+	{
+		if (limit->rate > 0 && limit->tokens + 1.0 <= limit->burst)
+			limit->tokens += 1.0;
+		return;
+	}
+
+	limit->stats.completed++;
+
+	if (status == 429 || status == 503)
+	{
+		limit->stats.throttled++;
+
+		/* multiplicative decrease, once per episode */
+		if (limit->decreased_at == 0 || now - limit->decreased_at > LIMIT_DECREASE_HOLD)
+		{
+			limit->window /= 2;
+			if (limit->window < 1)
+				limit->window = 1;
+			limit->decreased_at = now;
+			limit->stats.decreases++;
+		}
+
+		/* the server said when to come back */
+		if (retry_after && now + (uint64_t)retry_after * 1000000 > limit->paused_until)
+			limit->paused_until = now + (uint64_t)retry_after * 1000000;
+	}
+	else
+	{
+		/* additive increase, about one slot per window of completions */
+		limit->window += 1.0 / limit->window;
+		if (limit->window > limit->max_window)
+			limit->window = limit->max_window;
+	}
+
+	limit->stats.window = limit->window;
+}
+
+/* microseconds until libcohost_limit_acquire() could succeed, ignoring the window */
+uint64_t libcohost_limit_wait(libcohost_limit_t *limit, uint64_t now)
+{
+	uint64_t wait = 0, refill;
+
+	if (now < limit->paused_until)
+		wait = limit->paused_until - now;
+
+	if (limit->rate > 0)
+	{
+		limit_refill(limit, now);
+		if (limit->tokens < 1.0)
+		{
+			refill = (uint64_t)((1.0 - limit->tokens) * 1000000.0 / limit->rate) + 1;
+			if (refill > wait)
+				wait = refill;
+		}
+	}
+
+	return wait;
+}
+
+/* jittered exponential delay before retry number attempt */
+uint64_t libcohost_limit_backoff(libcohost_limit_t *limit, int attempt)
+{
+	uint64_t delay = LIMIT_BACKOFF_BASE;
+
+	while (attempt-- > 0 && delay < LIMIT_BACKOFF_MAX)
+		delay *= 2;
+	if (delay > LIMIT_BACKOFF_MAX)
+		delay = LIMIT_BACKOFF_MAX;
+
+	if (limit == NULL)
+		return delay;
+
+	/* half fixed, half random, so throttled clients spread out */
+	return delay / 2 + limit_random(limit) % (delay / 2 + 1);
+}
+
+/* copy out the limiter counters */
+void libcohost_limit_stats(libcohost_limit_t *limit, libcohost_limit_stats_t *stats)
+{
+	memcpy(stats, &limit->stats, sizeof(libcohost_limit_stats_t));
+}
@@ -0,0 +1,111 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_LIMIT_H_
+#define _LIBCOHOST_LIMIT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+
+/* times a throttled request is sent again before its callback sees the error */
+#ifndef LIBCOHOST_LIMIT_RETRIES
+#define LIBCOHOST_LIMIT_RETRIES (4)
+#endif
+
+/* limiter counters, times are in microseconds */
+typedef struct libcohost_limit_stats_t {
+	unsigned long started;
+	unsigned long completed;
+	unsigned long throttled; /* 429 and 503 responses */
+	unsigned long retries;
+	unsigned long decreases; /* times the window was halved */
+	unsigned long wait_us; /* time started requests spent queued */
+	unsigned long wait_max_us;
+	double window;
+	int active;
+} libcohost_limit_stats_t;
+
+/* token bucket pacing request starts, with an aimd window over concurrent transfers */
+typedef struct libcohost_limit_t {
+	double rate; /* tokens per second, 0 for no pacing */
+	double burst;
+	double tokens;
+	uint64_t refilled;
+	double window;
+	int max_window;
+	int active;
+	uint64_t paused_until; /* set by Retry-After */
+	uint64_t decreased_at;
+	uint32_t seed;
+	libcohost_limit_stats_t stats;
+} libcohost_limit_t;
+
+/* create a limiter starting rate requests per second, up to burst at once */
+/* and at most max_window transfers in flight, returns NULL on failure */
+libcohost_limit_t *libcohost_limit_new(double rate, int burst, int max_window);
+
+/* free a limiter */
+void libcohost_limit_free(libcohost_limit_t *limit);
+
+/* monotonic clock the limiter runs on */
+uint64_t libcohost_limit_now(void);
+
+/* take a token and a window slot for a request queued since queued */
+/* returns 0 if it has to wait */
+int libcohost_limit_acquire(libcohost_limit_t *limit, uint64_t queued, uint64_t now);
+
+/* give back the window slot of a finished request */
+/* status 0 means it never reached the server, and refunds its token */
+void libcohost_limit_release(libcohost_limit_t *limit, long status, unsigned long retry_after, uint64_t now);
+
+/* microseconds until libcohost_limit_acquire() could succeed, ignoring the window */
+uint64_t libcohost_limit_wait(libcohost_limit_t *limit, uint64_t now);
+
+/* jittered exponential delay before retry number attempt, no jitter without a limit */
+uint64_t libcohost_limit_backoff(libcohost_limit_t *limit, int attempt);
+
+/* copy out the limiter counters */
+void libcohost_limit_stats(libcohost_limit_t *limit, libcohost_limit_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_LIMIT_H_ */
@@ -0,0 +1,388 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "libcohost_pager.h"
+#include "libcohost_limit.h"
+
+/* seconds of scrolling to have fetched ahead, about a slow fetch and decode */
+#define PAGER_LEAD (2.0)
+
+/* weight of the newest velocity sample */
+#define PAGER_SMOOTHING (0.25)
+
+/* assumed size of a decoded page until one has arrived */
+#define PAGER_ESTIMATE (256 * 1024)
+
+/* memory a decoded page holds on to */
+static size_t page_bytes(const libcohost_page_t *page)
+{
+	return sizeof(libcohost_page_t) +
+		page->max_posts * sizeof(libcohost_post_t) +
+		page->max_projects * sizeof(libcohost_project_t) +
+		page->max_tags * sizeof(libcohost_intern_t) +
+		page->strings.size;
+}
+
+/* find the slot of a page number, NULL if it has none */
+static libcohost_pager_slot_t *pager_slot(libcohost_pager_t *pager, int number)
+{
+	int i;
+
+	for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+		if (pager->slots[i].number == number)
+			return &pager->slots[i];
+
+	return NULL;
+}
+
+/* find the failure record of a page number, NULL if it has none */
+static libcohost_pager_failure_t *pager_failure(libcohost_pager_t *pager, int number)
+{
+	int i;
+
+	for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+		if (pager->failed[i].number == number)
+			return &pager->failed[i];
+
+	return NULL;
+}
+
+/* returns 1 if page number shouldn't be fetched right now */
+static int pager_blocked(libcohost_pager_t *pager, int number)
+{
+	libcohost_pager_failure_t *failure = pager_failure(pager, number);
+
+	if (failure == NULL)
+		return 0;
+
+	return failure->fatal || libcohost_limit_now() < failure->retry_at;
+}
+
+/* note a failed fetch of page number and when to try it again */
+static void pager_fail(libcohost_pager_t *pager, int number, long status)
+{
+	libcohost_pager_failure_t *failure, *victim;
+	int i;
+
+	failure = pager_failure(pager, number);
+	if (failure == NULL)
+	{
+		/* take a free record, or the one of the lowest page, likely behind the reader */
+		failure = pager_failure(pager, -1);
+		if (failure == NULL)
+		{
+			victim = &pager->failed[0];
+			for (i = 1; i < LIBCOHOST_PAGER_SLOTS; i++)
+				if (pager->failed[i].number < victim->number)
+					victim = &pager->failed[i];
+			failure = victim;
+		}
+
+		failure->number = number;
+		failure->attempts = 0;
+	}
+
+	/* the server won't change its mind about these, timeouts and throttling aside */
+	failure->fatal = status >= 400 && status < 500 && status != 408 && status != 429;
+	/* the session limiter belongs to the worker thread, so go without its jitter */
+	failure->retry_at = libcohost_limit_now() + libcohost_limit_backoff(NULL, failure->attempts++);
+}
+
+/* release a slot and whatever it held */
+static void pager_drop(libcohost_pager_t *pager, libcohost_pager_slot_t *slot)
+{
+	if (slot->page)
+	{
+		pager->stats.bytes -= slot->bytes;
+		libcohost_page_free(slot->page);
+		free(slot->page);
+	}
+
+	slot->number = -1;
+	slot->request = NULL;
+	slot->page = NULL;
+	slot->bytes = 0;
+}
+
+/* a page arrived or failed */
+static void pager_done(libcohost_request_t *request, void *user)
+{
+	libcohost_pager_slot_t *slot = (libcohost_pager_slot_t *)user;
+	libcohost_pager_t *pager = slot->pager;
+	libcohost_pager_failure_t *failure;
+	libcohost_page_t *page;
+
+	slot->request = NULL;
+
+	if (request->result != LIBCOHOST_RESULT_OK || request->status != 200 || request->page == NULL)
+	{
+		pager->stats.failures++;
+		pager_fail(pager, slot->number, request->result == LIBCOHOST_RESULT_OK ? request->status : 0);
+		pager_drop(pager, slot);
+		return;
+	}
+
+	/* it worked this time, forget earlier failures */
+	failure = pager_failure(pager, slot->number);
+	if (failure)
+		failure->number = -1;
+
+	/* take ownership of the page */
+	page = request->page;
+	request->page = NULL;
+
+	/* an empty page is the end of the feed */
+	if (page->num_posts == 0)
+	{
+		if (pager->end < 0 || slot->number < pager->end)
+			pager->end = slot->number;
+		libcohost_page_free(page);
+		free(page);
+		pager_drop(pager, slot);
+		return;
+	}
+
+	slot->page = page;
+	slot->bytes = page_bytes(page);
+
+	pager->stats.pages++;
+	pager->stats.fetched_bytes += slot->bytes;
+	pager->stats.bytes += slot->bytes;
+	if (pager->stats.bytes > pager->stats.peak_bytes)
+		pager->stats.peak_bytes = pager->stats.bytes;
+}
+
+/* start fetching page number into slot */
+static int pager_request(libcohost_pager_t *pager, libcohost_pager_slot_t *slot, int number)
+{
+	libcohost_request_t *request;
+
+	request = libcohost_project_posts(pager->session, pager->handle, number, pager_done, slot);
+	if (request == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	slot->number = number;
+	slot->request = request;
+	pager->stats.requests++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* bring the pages ahead of the reader in line with the window and budget */
+static void pager_fill(libcohost_pager_t *pager)
+{
+	libcohost_pager_slot_t *slot, *victim;
+	size_t estimate, committed;
+	int i, number, last;
+
+	last = pager->next + pager->ahead;
+	if (pager->end >= 0 && last > pager->end)
+		last = pager->end;
+
+	/* over budget, drop pages past the window, furthest first */
+	while (pager->stats.bytes > pager->budget)
+	{
+		victim = NULL;
+		for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+		{
+			slot = &pager->slots[i];
+			if (slot->page && slot->number >= last && (victim == NULL || slot->number > victim->number))
+				victim = slot;
+		}
+
+		if (victim == NULL)
+			break;
+
+		pager->stats.evictions++;
+		pager->stats.wasted_bytes += victim->bytes;
+		pager_drop(pager, victim);
+	}
+
+	/* pages in flight are counted at the average size seen so far */
+	estimate = pager->stats.pages ? pager->stats.fetched_bytes / pager->stats.pages : PAGER_ESTIMATE;
+	committed = pager->stats.bytes;
+	for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+		if (pager->slots[i].request)
+			committed += estimate;
+
+	for (number = pager->next; number < last; number++)
+	{
+		if (pager_slot(pager, number) || pager_blocked(pager, number))
+			continue;
+
+		/* the next page is always fetched, the rest only within budget */
+		if (number != pager->next && committed + estimate > pager->budget)
+			break;
+
+		slot = pager_slot(pager, -1);
+		if (slot == NULL || pager_request(pager, slot, number) != LIBCOHOST_RESULT_OK)
+			break;
+
+		committed += estimate;
+	}
+}
+
+/* setup a pager for the posts of handle, starting at page first */
+int libcohost_pager_init(libcohost_pager_t *pager, libcohost_session_t *session, const char *handle, int first, size_t budget)
+{
+	int i;
+
+	memset(pager, 0, sizeof(libcohost_pager_t));
+
+	if (strlen(handle) >= sizeof(pager->handle))
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	strcpy(pager->handle, handle);
+	pager->session = session;
+	pager->budget = budget;
+	pager->next = first;
+	pager->end = -1;
+	pager->asked = -1;
+	pager->ahead = 1;
+
+	for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+	{
+		pager->slots[i].number = -1;
+		pager->slots[i].pager = pager;
+		pager->failed[i].number = -1;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* report the reader's position in pages at time ms, and prefetch to match */
+void libcohost_pager_scroll(libcohost_pager_t *pager, double position, unsigned long ms)
+{
+	double velocity;
+
+	/* only forward motion needs pages fetched ahead */
+	if (pager->last_ms && ms > pager->last_ms)
+	{
+		velocity = (position - pager->position) * 1000.0 / (double)(ms - pager->last_ms);
+		if (velocity < 0)
+			velocity = 0;
+		pager->velocity += (velocity - pager->velocity) * PAGER_SMOOTHING;
+	}
+
+	pager->position = position;
+	pager->last_ms = ms;
+
+	/* enough pages to cover the lead time at the current speed */
+	pager->ahead = 1 + (int)(pager->velocity * PAGER_LEAD);
+	if (pager->ahead > LIBCOHOST_PAGER_SLOTS)
+		pager->ahead = LIBCOHOST_PAGER_SLOTS;
+
+	pager_fill(pager);
+}
+
+/* take page number if it has arrived, the caller owns and frees it */
+libcohost_page_t *libcohost_pager_take(libcohost_pager_t *pager, int number)
+{
+	libcohost_pager_slot_t *slot;
+	libcohost_page_t *page;
+
+	if (pager->end >= 0 && number >= pager->end)
+		return NULL;
+
+	slot = pager_slot(pager, number);
+
+	/* not there yet, count the miss once and make sure it's coming */
+	if (slot == NULL || slot->page == NULL)
+	{
+		if (pager->asked != number)
+		{
+			pager->asked = number;
+			pager->stats.misses++;
+		}
+
+		if (slot == NULL && !pager_blocked(pager, number) && (slot = pager_slot(pager, -1)) != NULL)
+			pager_request(pager, slot, number);
+
+		return NULL;
+	}
+
+	if (pager->asked != number)
+		pager->stats.hits++;
+
+	/* hand it over */
+	page = slot->page;
+	pager->stats.bytes -= slot->bytes;
+	slot->page = NULL;
+	pager_drop(pager, slot);
+
+	if (number >= pager->next)
+		pager->next = number + 1;
+
+	pager_fill(pager);
+
+	return page;
+}
+
+/* copy out the pager counters */
+void libcohost_pager_stats(libcohost_pager_t *pager, libcohost_pager_stats_t *stats)
+{
+	memcpy(stats, &pager->stats, sizeof(libcohost_pager_stats_t));
+}
+
+/* cancel prefetches and drop the pages nobody took */
+void libcohost_pager_free(libcohost_pager_t *pager)
+{
+	libcohost_pager_slot_t *slot;
+	int i;
+
+	for (i = 0; i < LIBCOHOST_PAGER_SLOTS; i++)
+	{
+		slot = &pager->slots[i];
+
+		/* the callback still fires later, keep it away from the pager */
+		if (slot->request)
+		{
+			libcohost_request_cancel(pager->session, slot->request);
+			slot->request->callback = NULL;
+		}
+
+		if (slot->page)
+			pager->stats.wasted_bytes += slot->bytes;
+
+		pager_drop(pager, slot);
+	}
+}
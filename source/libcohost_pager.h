@@ -0,0 +1,121 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_PAGER_H_
+#define _LIBCOHOST_PAGER_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+#include "libcohost_post.h"
+
+/* most pages fetched or held ahead of the reader at once */
+#define LIBCOHOST_PAGER_SLOTS (8)
+
+/* pager counters */
+typedef struct libcohost_pager_stats_t {
+	unsigned long requests;
+	unsigned long failures;
+	unsigned long pages;
+	unsigned long hits; /* page was ready the first time it was asked for */
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned long bytes; /* held right now */
+	unsigned long peak_bytes;
+	unsigned long fetched_bytes;
+	unsigned long wasted_bytes; /* fetched, then dropped without being taken */
+} libcohost_pager_stats_t;
+
+/* one page being fetched or waiting to be taken */
+typedef struct libcohost_pager_slot_t {
+	int number; /* -1 when unused */
+	libcohost_request_t *request;
+	libcohost_page_t *page;
+	size_t bytes;
+	struct libcohost_pager_t *pager;
+} libcohost_pager_slot_t;
+
+/* a page number whose last fetch failed */
+typedef struct libcohost_pager_failure_t {
+	int number; /* -1 when unused */
+	int attempts;
+	int fatal; /* a 4xx that asking again won't change */
+	uint64_t retry_at; /* limiter clock */
+} libcohost_pager_failure_t;
+
+/* prefetches the pages of a project's posts ahead of the reader */
+typedef struct libcohost_pager_t {
+	libcohost_session_t *session;
+	char handle[64];
+	size_t budget; /* bytes of decoded pages held or in flight */
+	int next; /* next page the reader will take */
+	int end; /* first page known to be empty, -1 until one is seen */
+	int asked; /* last page a miss was counted for */
+	int ahead; /* pages to keep ahead, follows scroll velocity */
+	double position;
+	double velocity; /* pages per second */
+	unsigned long last_ms;
+	libcohost_pager_slot_t slots[LIBCOHOST_PAGER_SLOTS];
+	libcohost_pager_failure_t failed[LIBCOHOST_PAGER_SLOTS];
+	libcohost_pager_stats_t stats;
+} libcohost_pager_t;
+
+/* setup a pager for the posts of handle, starting at page first */
+/* callbacks run from libcohost_poll(), so use the pager from that thread only */
+int libcohost_pager_init(libcohost_pager_t *pager, libcohost_session_t *session, const char *handle, int first, size_t budget);
+
+/* report the reader's position in pages at time ms, and prefetch to match */
+void libcohost_pager_scroll(libcohost_pager_t *pager, double position, unsigned long ms);
+
+/* take page number if it has arrived, the caller owns and frees it */
+/* returns NULL while it's still in flight, fetching it if it wasn't */
+/* failed pages are fetched again with backoff, never after a 4xx other than 408 or 429 */
+libcohost_page_t *libcohost_pager_take(libcohost_pager_t *pager, int number);
+
+/* copy out the pager counters */
+void libcohost_pager_stats(libcohost_pager_t *pager, libcohost_pager_stats_t *stats);
+
+/* cancel prefetches and drop the pages nobody took */
+void libcohost_pager_free(libcohost_pager_t *pager);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_PAGER_H_ */
@@ -0,0 +1,742 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "thirdparty/cJSON.h"
+
+#include "libcohost_post.h"
+#include "libcohost_json.h"
+
+/* initial array capacities */
+#define POSTS_MIN (32)
+#define PROJECTS_MIN (16)
+#define TAGS_MIN (64)
+
+/* grow a page array to hold one more element */
+static int page_grow(void **array, int *max, int num, int min, size_t size)
+{
+	void *grown;
+	int want;
+
+	if (num < *max)
+		return LIBCOHOST_RESULT_OK;
+
+	want = *max ? *max * 2 : min;
+
+	grown = realloc(*array, want * size);
+	if (grown == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	*array = grown;
+	*max = want;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* copy a string into the blob, empty strings share offset 0 */
+static libcohost_string_t page_string_copy(libcohost_page_t *page, const char *s)
+{
+	libcohost_string_t offset;
+
+	if (s == NULL || *s == '\0')
+		return 0;
+
+	offset = (libcohost_string_t)page->strings.len;
+	if (libcohost_buffer_append(&page->strings, s, strlen(s) + 1) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	return offset;
+}
+
+/* copy a string member into the blob, missing or empty strings share offset 0 */
+static libcohost_string_t page_string_add(libcohost_page_t *page, const cJSON *json, const char *name)
+{
+	return page_string_copy(page, cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(json, name)));
+}
+
+/* intern a string member, missing strings get id 0 */
+static libcohost_intern_t page_intern(const cJSON *json, const char *name)
+{
+	const char *s = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(json, name));
+	return s ? libcohost_intern(s, strlen(s)) : 0;
+}
+
+/* get a numeric member, 0 if missing */
+static double json_number(const cJSON *json, const char *name)
+{
+	const cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+	return cJSON_IsNumber(item) ? item->valuedouble : 0;
+}
+
+/* set flag if a boolean member is true */
+static uint32_t json_flag(const cJSON *json, const char *name, uint32_t flag)
+{
+	return cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(json, name)) ? flag : 0;
+}
+
+/* parse an iso 8601 utc timestamp like 2024-01-31T12:00:00.000Z */
+static int64_t parse_time(const char *s)
+{
+	int year, month, day, hour, minute, second;
+	int64_t days;
+
+	if (sscanf(s, "%4d-%2d-%2dT%2d:%2d:%2d", &year, &month, &day, &hour, &minute, &second) != 6)
+		return 0;
+
+	/* days since the epoch in the proleptic gregorian calendar */
+	if (month <= 2)
+		year--;
+	days = (int64_t)365 * year + year / 4 - year / 100 + year / 400;
+	days += (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	days -= 719468;
+
+	return days * 86400 + hour * 3600 + minute * 60 + second;
+}
+
+/* get a timestamp member, 0 if missing */
+static int64_t json_time(const cJSON *json, const char *name)
+{
+	const char *s = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(json, name));
+	return s ? parse_time(s) : 0;
+}
+
+/* find or add the project a post was made by */
+static int page_project_add(libcohost_page_t *page, const cJSON *json)
+{
+	libcohost_project_t *project;
+	uint32_t project_id;
+	const char *privacy;
+	int i;
+
+	project_id = (uint32_t)json_number(json, "projectId");
+
+	for (i = 0; i < page->num_projects; i++)
+		if (page->projects[i].project_id == project_id)
+			return i;
+
+	if (page_grow((void **)&page->projects, &page->max_projects, page->num_projects, PROJECTS_MIN, sizeof(libcohost_project_t)) != LIBCOHOST_RESULT_OK)
+		return -1;
+
+	project = &page->projects[page->num_projects];
+	project->project_id = project_id;
+	project->handle = page_intern(json, "handle");
+	project->display_name = page_intern(json, "displayName");
+	project->avatar_url = page_intern(json, "avatarURL");
+
+	privacy = cJSON_GetStringValue(cJSON_GetObjectItemCaseSensitive(json, "privacy"));
+	project->flags = privacy && strcmp(privacy, "private") == 0 ? LIBCOHOST_PROJECT_PRIVATE : 0;
+	if (cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(json, "askSettings"), "enabled")))
+		project->flags |= LIBCOHOST_PROJECT_ASK_ENABLED;
+
+	return page->num_projects++;
+}
+
+/* setup an empty page */
+int libcohost_page_init(libcohost_page_t *page)
+{
+	memset(page, 0, sizeof(libcohost_page_t));
+
+	/* offset 0 is the shared empty string */
+	return libcohost_buffer_append(&page->strings, "", 1);
+}
+
+/* decode one post object and append it to the page */
+int libcohost_page_post_add(libcohost_page_t *page, const void *json)
+{
+	const cJSON *tag, *tags;
+	libcohost_post_t *post;
+	int project;
+
+	if (!cJSON_IsObject((const cJSON *)json) || !cJSON_GetObjectItemCaseSensitive(json, "postId"))
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	if (page_grow((void **)&page->posts, &page->max_posts, page->num_posts, POSTS_MIN, sizeof(libcohost_post_t)) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	project = page_project_add(page, cJSON_GetObjectItemCaseSensitive(json, "postingProject"));
+	if (project < 0)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	post = &page->posts[page->num_posts];
+	memset(post, 0, sizeof(libcohost_post_t));
+
+	post->post_id = (uint32_t)json_number(json, "postId");
+	post->share_of_post_id = (uint32_t)json_number(json, "transparentShareOfPostId");
+	post->published_at = json_time(json, "publishedAt");
+	post->project = (uint32_t)project;
+	post->num_comments = (uint16_t)json_number(json, "numComments");
+	post->headline = page_string_add(page, json, "headline");
+	post->body = page_string_add(page, json, "plainTextBody");
+	post->url = page_string_add(page, json, "singlePostPageUrl");
+
+	post->flags = post->share_of_post_id ? LIBCOHOST_POST_SHARE : 0;
+	post->flags |= json_flag(json, "effectiveAdultContent", LIBCOHOST_POST_ADULT);
+	post->flags |= json_flag(json, "isLiked", LIBCOHOST_POST_LIKED);
+	post->flags |= json_flag(json, "pinned", LIBCOHOST_POST_PINNED);
+	post->flags |= json_flag(json, "commentsLocked", LIBCOHOST_POST_COMMENTS_LOCKED);
+	post->flags |= json_flag(json, "sharesLocked", LIBCOHOST_POST_SHARES_LOCKED);
+	post->flags |= json_flag(json, "isEditor", LIBCOHOST_POST_EDITOR);
+
+	/* tags of a post are stored contiguously */
+	post->first_tag = (uint32_t)page->num_tags;
+	tags = cJSON_GetObjectItemCaseSensitive(json, "tags");
+	cJSON_ArrayForEach(tag, tags)
+	{
+		if (!cJSON_IsString(tag))
+			continue;
+		if (page_grow((void **)&page->tags, &page->max_tags, page->num_tags, TAGS_MIN, sizeof(libcohost_intern_t)) != LIBCOHOST_RESULT_OK)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+		page->tags[page->num_tags++] = libcohost_intern(tag->valuestring, strlen(tag->valuestring));
+		post->num_tags++;
+	}
+
+	page->num_posts++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* decode every post of a response with an items array */
+int libcohost_page_decode(libcohost_page_t *page, const void *json)
+{
+	const cJSON *item;
+	int r;
+
+	cJSON_ArrayForEach(item, cJSON_GetObjectItemCaseSensitive(json, "items"))
+	{
+		r = libcohost_page_post_add(page, item);
+		if (r == LIBCOHOST_RESULT_ALLOC_FAIL)
+			return r;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* get a string of the page */
+const char *libcohost_page_string(const libcohost_page_t *page, libcohost_string_t string)
+{
+	return string ? page->strings.data + string : "";
+}
+
+/* read a string in situ and get its offset in the page buffer */
+static libcohost_string_t reader_string(libcohost_page_t *page, libcohost_json_reader_t *reader)
+{
+	size_t len;
+	char *s;
+
+	if (libcohost_json_reader_string(reader, &s, &len) != LIBCOHOST_RESULT_OK || len == 0)
+		return 0;
+
+	return (libcohost_string_t)(s - page->strings.data);
+}
+
+/* read a string and intern it */
+static libcohost_intern_t reader_intern(libcohost_json_reader_t *reader)
+{
+	size_t len;
+	char *s;
+
+	if (libcohost_json_reader_string(reader, &s, &len) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	return libcohost_intern(s, len);
+}
+
+/* find a project by id or add it, returns its index in the page */
+static int page_project_insert(libcohost_page_t *page, const libcohost_project_t *project)
+{
+	int i;
+
+	for (i = 0; i < page->num_projects; i++)
+		if (page->projects[i].project_id == project->project_id)
+			return i;
+
+	if (page_grow((void **)&page->projects, &page->max_projects, page->num_projects, PROJECTS_MIN, sizeof(libcohost_project_t)) != LIBCOHOST_RESULT_OK)
+		return -1;
+
+	page->projects[page->num_projects] = *project;
+
+	return page->num_projects++;
+}
+
+/* read a project object in situ, returns its index in the page */
+static int page_project_read(libcohost_page_t *page, libcohost_json_reader_t *reader)
+{
+	libcohost_project_t project;
+	size_t len;
+	char *key, *s;
+
+	memset(&project, 0, sizeof(libcohost_project_t));
+
+	if (libcohost_json_reader_enter(reader) != LIBCOHOST_RESULT_OK)
+	{
+		libcohost_json_reader_skip(reader);
+	}
+	else
+	{
+		while (libcohost_json_reader_member(reader, &key, &len))
+		{
+			if (strcmp(key, "projectId") == 0)
+			{
+				project.project_id = (uint32_t)libcohost_json_reader_number(reader);
+			}
+			else if (strcmp(key, "handle") == 0)
+			{
+				project.handle = reader_intern(reader);
+			}
+			else if (strcmp(key, "displayName") == 0)
+			{
+				project.display_name = reader_intern(reader);
+			}
+			else if (strcmp(key, "avatarURL") == 0)
+			{
+				project.avatar_url = reader_intern(reader);
+			}
+			else if (strcmp(key, "privacy") == 0)
+			{
+				if (libcohost_json_reader_string(reader, &s, &len) == LIBCOHOST_RESULT_OK && strcmp(s, "private") == 0)
+					project.flags |= LIBCOHOST_PROJECT_PRIVATE;
+			}
+			else if (strcmp(key, "askSettings") == 0 && libcohost_json_reader_enter(reader) == LIBCOHOST_RESULT_OK)
+			{
+				while (libcohost_json_reader_member(reader, &key, &len))
+				{
+					if (strcmp(key, "enabled") == 0 && libcohost_json_reader_bool(reader))
+						project.flags |= LIBCOHOST_PROJECT_ASK_ENABLED;
+					else
+						libcohost_json_reader_skip(reader);
+				}
+			}
+			else
+			{
+				libcohost_json_reader_skip(reader);
+			}
+		}
+	}
+
+	return page_project_insert(page, &project);
+}
+
+/* read a post object in situ and append it to the page */
+static int page_post_read(libcohost_page_t *page, libcohost_json_reader_t *reader)
+{
+	libcohost_project_t empty;
+	libcohost_post_t *post;
+	int project = -1;
+	size_t len;
+	char *key;
+
+	if (page_grow((void **)&page->posts, &page->max_posts, page->num_posts, POSTS_MIN, sizeof(libcohost_post_t)) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	post = &page->posts[page->num_posts];
+	memset(post, 0, sizeof(libcohost_post_t));
+	post->first_tag = (uint32_t)page->num_tags;
+
+	if (libcohost_json_reader_enter(reader) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	while (libcohost_json_reader_member(reader, &key, &len))
+	{
+		if (strcmp(key, "postId") == 0)
+			post->post_id = (uint32_t)libcohost_json_reader_number(reader);
+		else if (strcmp(key, "transparentShareOfPostId") == 0)
+			post->share_of_post_id = (uint32_t)libcohost_json_reader_number(reader);
+		else if (strcmp(key, "numComments") == 0)
+			post->num_comments = (uint16_t)libcohost_json_reader_number(reader);
+		else if (strcmp(key, "headline") == 0)
+			post->headline = reader_string(page, reader);
+		else if (strcmp(key, "plainTextBody") == 0)
+			post->body = reader_string(page, reader);
+		else if (strcmp(key, "singlePostPageUrl") == 0)
+			post->url = reader_string(page, reader);
+		else if (strcmp(key, "publishedAt") == 0)
+			post->published_at = parse_time(libcohost_page_string(page, reader_string(page, reader)));
+		else if (strcmp(key, "effectiveAdultContent") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_ADULT : 0;
+		else if (strcmp(key, "isLiked") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_LIKED : 0;
+		else if (strcmp(key, "pinned") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_PINNED : 0;
+		else if (strcmp(key, "commentsLocked") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_COMMENTS_LOCKED : 0;
+		else if (strcmp(key, "sharesLocked") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_SHARES_LOCKED : 0;
+		else if (strcmp(key, "isEditor") == 0)
+			post->flags |= libcohost_json_reader_bool(reader) ? LIBCOHOST_POST_EDITOR : 0;
+		else if (strcmp(key, "postingProject") == 0)
+			project = page_project_read(page, reader);
+		else if (strcmp(key, "tags") == 0 && libcohost_json_reader_enter(reader) == LIBCOHOST_RESULT_OK)
+		{
+			while (libcohost_json_reader_element(reader))
+			{
+				if (page_grow((void **)&page->tags, &page->max_tags, page->num_tags, TAGS_MIN, sizeof(libcohost_intern_t)) != LIBCOHOST_RESULT_OK)
+					return LIBCOHOST_RESULT_ALLOC_FAIL;
+				page->tags[page->num_tags++] = reader_intern(reader);
+				post->num_tags++;
+			}
+		}
+		else
+			libcohost_json_reader_skip(reader);
+	}
+
+	/* posts without a project are filed under an empty one, like page_post_add() */
+	if (project < 0)
+	{
+		memset(&empty, 0, sizeof(libcohost_project_t));
+		project = page_project_insert(page, &empty);
+		if (project < 0)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	post->flags |= post->share_of_post_id ? LIBCOHOST_POST_SHARE : 0;
+	post->project = (uint32_t)project;
+
+	page->num_posts++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* append a post with its strings given directly, the page copies them */
+libcohost_post_t *libcohost_page_post_new(libcohost_page_t *page, const libcohost_project_t *project, const char *headline, const char *body, const char *url)
+{
+	libcohost_post_t *post;
+	int index;
+
+	if (page_grow((void **)&page->posts, &page->max_posts, page->num_posts, POSTS_MIN, sizeof(libcohost_post_t)) != LIBCOHOST_RESULT_OK)
+		return NULL;
+
+	index = page_project_insert(page, project);
+	if (index < 0)
+		return NULL;
+
+	post = &page->posts[page->num_posts];
+	memset(post, 0, sizeof(libcohost_post_t));
+	post->project = (uint32_t)index;
+	post->first_tag = (uint32_t)page->num_tags;
+	post->headline = page_string_copy(page, headline);
+	post->body = page_string_copy(page, body);
+	post->url = page_string_copy(page, url);
+
+	page->num_posts++;
+
+	return post;
+}
+
+/* add a tag to the post last appended */
+int libcohost_page_tag_add(libcohost_page_t *page, libcohost_post_t *post, libcohost_intern_t tag)
+{
+	if (page_grow((void **)&page->tags, &page->max_tags, page->num_tags, TAGS_MIN, sizeof(libcohost_intern_t)) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	page->tags[page->num_tags++] = tag;
+	post->num_tags++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* decode the posts of an index in situ, the page takes over its response */
+int libcohost_page_decode_index(libcohost_page_t *page, libcohost_json_index_t *index)
+{
+	libcohost_json_reader_t reader;
+	int i, r = LIBCOHOST_RESULT_OK;
+
+	/* strings of this page become offsets into the response itself */
+	libcohost_buffer_free(&page->strings);
+	memcpy(&page->strings, &index->raw, sizeof(libcohost_buffer_t));
+	memset(&index->raw, 0, sizeof(libcohost_buffer_t));
+
+	for (i = 0; i < index->num_items; i++)
+	{
+		libcohost_json_reader_init(&reader, page->strings.data + index->items[i].offset, index->items[i].len);
+		r = page_post_read(page, &reader);
+		if (r == LIBCOHOST_RESULT_ALLOC_FAIL)
+			break;
+	}
+
+	/* the spans pointed into the response, so the index is left empty */
+	free(index->items);
+	index->items = NULL;
+	index->num_items = 0;
+	index->max_items = 0;
+
+	return r == LIBCOHOST_RESULT_ALLOC_FAIL ? r : LIBCOHOST_RESULT_OK;
+}
+
+/* page serialization header */
+typedef struct page_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t post_size;
+	uint32_t num_posts;
+	uint32_t num_projects;
+	uint32_t num_tags;
+	uint64_t strings_len;
+} page_header_t;
+
+/* serialized project, its strings follow */
+typedef struct page_project_t {
+	uint32_t project_id;
+	uint32_t flags;
+} page_project_t;
+
+#define PAGE_MAGIC (0x47504843) /* "CHPG" */
+#define PAGE_VERSION (1)
+
+/* write an interned string out in full */
+static int save_intern(libcohost_buffer_t *out, libcohost_intern_t id)
+{
+	const char *s = libcohost_intern_string(id);
+	return libcohost_buffer_append(out, s, strlen(s) + 1);
+}
+
+/* copy a page string into a fresh blob */
+static libcohost_string_t save_string(libcohost_buffer_t *blob, const libcohost_page_t *page, libcohost_string_t string)
+{
+	const char *s = libcohost_page_string(page, string);
+	libcohost_string_t offset = (libcohost_string_t)blob->len;
+
+	if (*s == '\0')
+		return 0;
+	if (libcohost_buffer_append(blob, s, strlen(s) + 1) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	return offset;
+}
+
+/* serialize a page into out, interned strings are written out in full */
+int libcohost_page_save(const libcohost_page_t *page, libcohost_buffer_t *out)
+{
+	libcohost_buffer_t blob;
+	page_header_t header;
+	page_project_t project;
+	libcohost_post_t post;
+	size_t base = out->len;
+	int i, r = LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	/* in situ pages hold the whole response, so only used strings are kept */
+	memset(&blob, 0, sizeof(blob));
+	if (libcohost_buffer_append(&blob, "", 1) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	memset(&header, 0, sizeof(header));
+	if (libcohost_buffer_append(out, &header, sizeof(header)) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	for (i = 0; i < page->num_posts; i++)
+	{
+		post = page->posts[i];
+		post.headline = save_string(&blob, page, post.headline);
+		post.body = save_string(&blob, page, post.body);
+		post.url = save_string(&blob, page, post.url);
+		if (libcohost_buffer_append(out, &post, sizeof(post)) != LIBCOHOST_RESULT_OK)
+			goto done;
+	}
+
+	for (i = 0; i < page->num_projects; i++)
+	{
+		project.project_id = page->projects[i].project_id;
+		project.flags = page->projects[i].flags;
+		if (libcohost_buffer_append(out, &project, sizeof(project)) != LIBCOHOST_RESULT_OK ||
+			save_intern(out, page->projects[i].handle) != LIBCOHOST_RESULT_OK ||
+			save_intern(out, page->projects[i].display_name) != LIBCOHOST_RESULT_OK ||
+			save_intern(out, page->projects[i].avatar_url) != LIBCOHOST_RESULT_OK)
+			goto done;
+	}
+
+	for (i = 0; i < page->num_tags; i++)
+		if (save_intern(out, page->tags[i]) != LIBCOHOST_RESULT_OK)
+			goto done;
+
+	if (libcohost_buffer_append(out, blob.data, blob.len) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	/* header goes in last, once the blob size is known */
+	header.magic = PAGE_MAGIC;
+	header.version = PAGE_VERSION;
+	header.post_size = sizeof(libcohost_post_t);
+	header.num_posts = (uint32_t)page->num_posts;
+	header.num_projects = (uint32_t)page->num_projects;
+	header.num_tags = (uint32_t)page->num_tags;
+	header.strings_len = blob.len;
+	memcpy(out->data + base, &header, sizeof(header));
+
+	r = LIBCOHOST_RESULT_OK;
+
+done:
+	libcohost_buffer_free(&blob);
+	return r;
+}
+
+/* read back a string written by save_intern() */
+static libcohost_intern_t restore_intern(const char *data, size_t *pos, size_t len)
+{
+	const char *s = data + *pos;
+	const char *end = memchr(s, '\0', len - *pos);
+
+	if (end == NULL)
+		return 0;
+
+	*pos += end - s + 1;
+
+	return libcohost_intern(s, end - s);
+}
+
+/* restore a page written by libcohost_page_save() into an empty page */
+size_t libcohost_page_restore(libcohost_page_t *page, const void *data, size_t len)
+{
+	const char *bytes = data;
+	page_header_t header;
+	page_project_t project;
+	size_t pos, posts_len;
+	uint32_t i;
+
+	if (len < sizeof(header))
+		return 0;
+
+	memcpy(&header, bytes, sizeof(header));
+	if (header.magic != PAGE_MAGIC || header.version != PAGE_VERSION || header.post_size != sizeof(libcohost_post_t))
+		return 0;
+
+	pos = sizeof(header);
+	posts_len = (size_t)header.num_posts * sizeof(libcohost_post_t);
+	if (posts_len > len - pos)
+		return 0;
+
+	/* every project and tag takes up bytes, so the counts can't be bigger than what's left */
+	if (header.num_projects > (len - pos - posts_len) / sizeof(project) || header.num_tags > len - pos - posts_len)
+		return 0;
+
+	page->posts = malloc(posts_len + 1);
+	page->projects = malloc((size_t)header.num_projects * sizeof(libcohost_project_t) + 1);
+	page->tags = malloc((size_t)header.num_tags * sizeof(libcohost_intern_t) + 1);
+	if (page->posts == NULL || page->projects == NULL || page->tags == NULL)
+		return 0;
+
+	memcpy(page->posts, bytes + pos, posts_len);
+	page->num_posts = page->max_posts = (int)header.num_posts;
+	pos += posts_len;
+
+	for (i = 0; i < header.num_projects; i++)
+	{
+		if (sizeof(project) > len - pos)
+			return 0;
+		memcpy(&project, bytes + pos, sizeof(project));
+		pos += sizeof(project);
+
+		page->projects[i].project_id = project.project_id;
+		page->projects[i].flags = project.flags;
+		page->projects[i].handle = restore_intern(bytes, &pos, len);
+		page->projects[i].display_name = restore_intern(bytes, &pos, len);
+		page->projects[i].avatar_url = restore_intern(bytes, &pos, len);
+	}
+	page->num_projects = page->max_projects = (int)header.num_projects;
+
+	for (i = 0; i < header.num_tags; i++)
+		page->tags[i] = restore_intern(bytes, &pos, len);
+	page->num_tags = page->max_tags = (int)header.num_tags;
+
+	if (header.strings_len > len - pos)
+		return 0;
+
+	libcohost_buffer_reset(&page->strings);
+	if (libcohost_buffer_append(&page->strings, bytes + pos, header.strings_len) != LIBCOHOST_RESULT_OK)
+		return 0;
+	pos += header.strings_len;
+
+	/* don't trust indices and offsets that point outside the page */
+	for (i = 0; i < header.num_posts; i++)
+	{
+		if (page->posts[i].project >= header.num_projects ||
+			page->posts[i].first_tag > header.num_tags ||
+			page->posts[i].num_tags > header.num_tags - page->posts[i].first_tag ||
+			page->posts[i].headline >= header.strings_len ||
+			page->posts[i].body >= header.strings_len ||
+			page->posts[i].url >= header.strings_len)
+			return 0;
+	}
+
+	return pos;
+}
+
+/* make page an independent copy of from, replacing what it held */
+int libcohost_page_copy(libcohost_page_t *page, const libcohost_page_t *from)
+{
+	libcohost_page_t copy;
+
+	memset(&copy, 0, sizeof(copy));
+
+	/* exact sizes, a copy isn't appended to */
+	copy.posts = malloc(from->num_posts * sizeof(libcohost_post_t) + 1);
+	copy.projects = malloc(from->num_projects * sizeof(libcohost_project_t) + 1);
+	copy.tags = malloc(from->num_tags * sizeof(libcohost_intern_t) + 1);
+	if (copy.posts == NULL || copy.projects == NULL || copy.tags == NULL ||
+		libcohost_buffer_append(&copy.strings, from->strings.data, from->strings.len) != LIBCOHOST_RESULT_OK)
+	{
+		libcohost_page_free(&copy);
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	if (from->num_posts)
+		memcpy(copy.posts, from->posts, from->num_posts * sizeof(libcohost_post_t));
+	if (from->num_projects)
+		memcpy(copy.projects, from->projects, from->num_projects * sizeof(libcohost_project_t));
+	if (from->num_tags)
+		memcpy(copy.tags, from->tags, from->num_tags * sizeof(libcohost_intern_t));
+	copy.num_posts = copy.max_posts = from->num_posts;
+	copy.num_projects = copy.max_projects = from->num_projects;
+	copy.num_tags = copy.max_tags = from->num_tags;
+
+	libcohost_page_free(page);
+	memcpy(page, &copy, sizeof(libcohost_page_t));
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* release page memory */
+void libcohost_page_free(libcohost_page_t *page)
+{
+	free(page->posts);
+	free(page->projects);
+	free(page->tags);
+	libcohost_buffer_free(&page->strings);
+	memset(page, 0, sizeof(libcohost_page_t));
+}
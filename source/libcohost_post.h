@@ -0,0 +1,162 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_POST_H_
+#define _LIBCOHOST_POST_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+#include "libcohost_intern.h"
+
+/* post flags */
+enum {
+	LIBCOHOST_POST_SHARE = 1 << 0,
+	LIBCOHOST_POST_ADULT = 1 << 1,
+	LIBCOHOST_POST_LIKED = 1 << 2,
+	LIBCOHOST_POST_PINNED = 1 << 3,
+	LIBCOHOST_POST_COMMENTS_LOCKED = 1 << 4,
+	LIBCOHOST_POST_SHARES_LOCKED = 1 << 5,
+	LIBCOHOST_POST_EDITOR = 1 << 6
+};
+
+/* project flags */
+enum {
+	LIBCOHOST_PROJECT_PRIVATE = 1 << 0,
+	LIBCOHOST_PROJECT_ASK_ENABLED = 1 << 1
+};
+
+/* offset of a string in the page string blob, 0 is the empty string */
+typedef uint32_t libcohost_string_t;
+
+/* project, stored once per page with its strings interned */
+typedef struct libcohost_project_t {
+	uint32_t project_id;
+	uint32_t flags;
+	libcohost_intern_t handle;
+	libcohost_intern_t display_name;
+	libcohost_intern_t avatar_url;
+} libcohost_project_t;
+
+/* post, strings point into the page string blob */
+typedef struct libcohost_post_t {
+	uint32_t post_id;
+	uint32_t share_of_post_id;
+	int64_t published_at; /* seconds since the epoch */
+	uint32_t project; /* index into the page projects */
+	uint32_t first_tag; /* index into the page tags */
+	uint16_t num_tags;
+	uint16_t num_comments;
+	uint32_t flags;
+	libcohost_string_t headline;
+	libcohost_string_t body;
+	libcohost_string_t url;
+} libcohost_post_t;
+
+/* page of posts decoded from one api response */
+typedef struct libcohost_page_t {
+	libcohost_post_t *posts;
+	int num_posts;
+	int max_posts;
+	libcohost_project_t *projects;
+	int num_projects;
+	int max_projects;
+	libcohost_intern_t *tags;
+	int num_tags;
+	int max_tags;
+	libcohost_buffer_t strings;
+} libcohost_page_t;
+
+/* setup an empty page */
+/* returns LIBCOHOST_RESULT_ALLOC_FAIL on failure */
+int libcohost_page_init(libcohost_page_t *page);
+
+/* decode one post object and append it to the page */
+/* returns LIBCOHOST_RESULT_GENERAL_FAIL if json is not a post */
+int libcohost_page_post_add(libcohost_page_t *page, const void *json);
+
+/* decode every post of a response with an items array */
+int libcohost_page_decode(libcohost_page_t *page, const void *json);
+
+/* append a post with its strings given directly, the page copies them */
+/* returns NULL on failure */
+libcohost_post_t *libcohost_page_post_new(libcohost_page_t *page, const libcohost_project_t *project, const char *headline, const char *body, const char *url);
+
+/* add a tag to the post last appended */
+int libcohost_page_tag_add(libcohost_page_t *page, libcohost_post_t *post, libcohost_intern_t tag);
+
+/* decode the posts of an index in situ, the page takes over its response */
+/* strings are unescaped inside the response and used from there */
+/* the index is left empty, only its key is kept */
+int libcohost_page_decode_index(libcohost_page_t *page, struct libcohost_json_index_t *index);
+
+/* get a string of the page */
+const char *libcohost_page_string(const libcohost_page_t *page, libcohost_string_t string);
+
+/* serialize a page into out, interned strings are written out in full */
+int libcohost_page_save(const libcohost_page_t *page, libcohost_buffer_t *out);
+
+/* restore a page written by libcohost_page_save() into an empty page */
+/* returns the number of bytes consumed, 0 on failure */
+size_t libcohost_page_restore(libcohost_page_t *page, const void *data, size_t len);
+
+/* make page an independent copy of from, replacing what it held */
+int libcohost_page_copy(libcohost_page_t *page, const libcohost_page_t *from);
+
+/* release page memory */
+void libcohost_page_free(libcohost_page_t *page);
+
+/* decode the response into request->page as it streams in, no tree is kept */
+/* set request->page to NULL in the callback to take ownership of the page */
+int libcohost_request_page_set(libcohost_request_t *request);
+
+/* keep the response and decode it in situ into request->page once complete */
+/* the response moves to the page, so request->index is empty in the callback */
+/* set request->page to NULL in the callback to take ownership of the page */
+int libcohost_request_page_insitu_set(libcohost_request_t *request);
+
+/* fetch one page of a project's posts, decoded into request->page */
+/* returns NULL on failure */
+libcohost_request_t *libcohost_project_posts(libcohost_session_t *session, const char *handle, int page, libcohost_callback_t callback, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_POST_H_ */
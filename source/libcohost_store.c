@@ -0,0 +1,814 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libcohost_store.h"
+
+/* file identification */
+#define DATA_MAGIC (0x44504843) /* "CHPD" */
+#define INDEX_MAGIC (0x49504843) /* "CHPI" */
+#define STORE_VERSION (1)
+#define DATA_NAME "posts.dat"
+#define INDEX_NAME "posts.idx"
+
+/* records are padded so the next one stays aligned */
+#define RECORD_ALIGN (8)
+
+/* data file header, committed is the commit marker */
+/* bytes past it were never committed and are dropped on open */
+typedef struct data_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t generation;
+	uint64_t committed;
+	uint64_t records;
+	uint64_t timeline_offset;
+	uint32_t timeline_count;
+	uint32_t record_size;
+	uint64_t reserved[2];
+} data_header_t;
+
+/* index file header, it must match the data file it was built for */
+typedef struct index_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t generation;
+	uint64_t committed;
+	uint64_t count;
+} index_header_t;
+
+/* index entry, sorted by post id */
+typedef struct index_entry_t {
+	uint32_t post_id;
+	uint32_t size;
+	uint64_t offset;
+} index_entry_t;
+
+/* build path of a file inside the store directory */
+static void store_path(libcohost_store_t *store, char *out, size_t len, const char *name)
+{
+	snprintf(out, len, "%s/%s", store->path, name);
+}
+
+/* get the mapped data file header */
+static data_header_t *store_header(libcohost_store_t *store)
+{
+	return (data_header_t *)store->data;
+}
+
+/* get the mapped index entries */
+static index_entry_t *store_entries(libcohost_store_t *store, uint64_t *count)
+{
+	index_header_t *header = store->index;
+
+	if (header == NULL)
+	{
+		*count = 0;
+		return NULL;
+	}
+
+	*count = header->count;
+	return (index_entry_t *)(header + 1);
+}
+
+/* check that a string of a record starts and ends inside it, returns its end */
+static uint32_t record_string_end(const libcohost_store_record_t *record, uint32_t offset)
+{
+	const char *end;
+
+	if (offset == 0)
+		return 0;
+	if (offset < sizeof(libcohost_store_record_t) || offset >= record->size)
+		return UINT32_MAX;
+
+	end = memchr((const char *)record + offset, '\0', record->size - offset);
+	if (end == NULL)
+		return UINT32_MAX;
+
+	return (uint32_t)(end - (const char *)record) + 1;
+}
+
+/* check that every string and tag of a record stays inside it */
+static int record_valid(const libcohost_store_record_t *record)
+{
+	uint32_t offset;
+	int i;
+
+	if (record_string_end(record, record->headline) == UINT32_MAX ||
+		record_string_end(record, record->body) == UINT32_MAX ||
+		record_string_end(record, record->url) == UINT32_MAX ||
+		record_string_end(record, record->handle) == UINT32_MAX ||
+		record_string_end(record, record->display_name) == UINT32_MAX ||
+		record_string_end(record, record->avatar_url) == UINT32_MAX)
+		return 0;
+
+	/* tags are only read when there are some, and then they must be there */
+	if (record->num_tags == 0)
+		return 1;
+
+	offset = record->tags;
+	for (i = 0; i < record->num_tags; i++)
+	{
+		offset = record_string_end(record, offset);
+		if (offset == 0 || offset == UINT32_MAX)
+			return 0;
+	}
+
+	return 1;
+}
+
+/* check that a record and its strings fit in the committed part of the file */
+static const libcohost_store_record_t *store_record(libcohost_store_t *store, uint64_t offset)
+{
+	const libcohost_store_record_t *record;
+
+	if (offset < sizeof(data_header_t) || offset + sizeof(libcohost_store_record_t) > store->data_size)
+		return NULL;
+
+	record = (const libcohost_store_record_t *)((const char *)store->data + offset);
+	if (record->size < sizeof(libcohost_store_record_t) || record->size % RECORD_ALIGN || offset + record->size > store->data_size)
+		return NULL;
+
+	if (!record_valid(record))
+		return NULL;
+
+	return record;
+}
+
+/* map the committed part of the data file */
+static int store_map_data(libcohost_store_t *store)
+{
+	data_header_t header;
+	void *data;
+
+	if (pread(store->fd, &header, sizeof(header), 0) != sizeof(header))
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	data = mmap(NULL, header.committed, PROT_READ, MAP_SHARED, store->fd, 0);
+	if (data == MAP_FAILED)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	if (store->data)
+		munmap(store->data, store->data_size);
+
+	store->data = data;
+	store->data_size = header.committed;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* map the index file, fails if it doesn't belong to the mapped data file */
+static int store_map_index(libcohost_store_t *store)
+{
+	char path[1024];
+	index_header_t *header;
+	index_entry_t *entries;
+	struct stat st;
+	void *index;
+	uint64_t i;
+	int fd;
+
+	if (store->index)
+		munmap(store->index, store->index_size);
+	store->index = NULL;
+	store->index_size = 0;
+
+	store_path(store, path, sizeof(path), INDEX_NAME);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(index_header_t))
+	{
+		close(fd);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	index = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (index == MAP_FAILED)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	header = index;
+	if (header->magic != INDEX_MAGIC || header->version != STORE_VERSION ||
+		header->generation != store_header(store)->generation ||
+		header->committed != store_header(store)->committed ||
+		sizeof(index_header_t) + header->count * sizeof(index_entry_t) != (uint64_t)st.st_size)
+	{
+		munmap(index, st.st_size);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	store->index = index;
+	store->index_size = st.st_size;
+
+	entries = (index_entry_t *)(header + 1);
+	store->stats.live_records = header->count;
+	store->stats.live_bytes = 0;
+	for (i = 0; i < header->count; i++)
+		store->stats.live_bytes += entries[i].size;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* order entries by post id, then by age */
+static int entry_compare(const void *a, const void *b)
+{
+	const index_entry_t *x = a, *y = b;
+
+	if (x->post_id != y->post_id)
+		return x->post_id < y->post_id ? -1 : 1;
+	if (x->offset != y->offset)
+		return x->offset < y->offset ? -1 : 1;
+	return 0;
+}
+
+/* sort entries and keep only the newest one of each post */
+static uint64_t entries_settle(index_entry_t *entries, uint64_t count)
+{
+	uint64_t i, out = 0;
+
+	qsort(entries, count, sizeof(index_entry_t), entry_compare);
+
+	for (i = 0; i < count; i++)
+	{
+		if (i + 1 < count && entries[i + 1].post_id == entries[i].post_id)
+			continue;
+		entries[out++] = entries[i];
+	}
+
+	return out;
+}
+
+/* atomically replace the index file and map it */
+static int store_index_write(libcohost_store_t *store, const index_entry_t *entries, uint64_t count)
+{
+	char path[1024], tmp[1024];
+	index_header_t header;
+	FILE *file;
+
+	store_path(store, path, sizeof(path), INDEX_NAME);
+	store_path(store, tmp, sizeof(tmp), INDEX_NAME ".tmp");
+
+	file = fopen(tmp, "wb");
+	if (file == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = INDEX_MAGIC;
+	header.version = STORE_VERSION;
+	header.generation = store_header(store)->generation;
+	header.committed = store_header(store)->committed;
+	header.count = count;
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+		(count && fwrite(entries, sizeof(index_entry_t), count, file) != count) ||
+		fflush(file) != 0 || fsync(fileno(file)) != 0)
+	{
+		fclose(file);
+		remove(tmp);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	fclose(file);
+
+	if (rename(tmp, path) != 0)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	return store_map_index(store);
+}
+
+/* rebuild the index by walking every committed record */
+static int store_index_rebuild(libcohost_store_t *store)
+{
+	const libcohost_store_record_t *record;
+	index_entry_t *entries;
+	uint64_t offset, count = 0;
+	int r;
+
+	entries = malloc((store_header(store)->records + 1) * sizeof(index_entry_t));
+	if (entries == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	for (offset = sizeof(data_header_t); count < store_header(store)->records; offset += record->size)
+	{
+		record = store_record(store, offset);
+		if (record == NULL)
+			break;
+
+		entries[count].post_id = record->post_id;
+		entries[count].size = record->size;
+		entries[count].offset = offset;
+		count++;
+	}
+
+	r = store_index_write(store, entries, entries_settle(entries, count));
+	free(entries);
+
+	store->stats.index_rebuilds++;
+
+	return r;
+}
+
+/* append a string to a record being built, returns its offset in the record */
+static uint32_t record_string(libcohost_buffer_t *out, size_t base, const char *s)
+{
+	size_t offset = out->len - base;
+
+	if (s == NULL || *s == '\0')
+		return 0;
+
+	if (libcohost_buffer_append(out, s, strlen(s) + 1) != LIBCOHOST_RESULT_OK)
+		return 0;
+
+	return (uint32_t)offset;
+}
+
+/* serialize one post of a page */
+static int record_build(libcohost_buffer_t *out, const libcohost_page_t *page, const libcohost_post_t *post)
+{
+	static const char zeros[RECORD_ALIGN] = {0};
+	const libcohost_project_t *project = &page->projects[post->project];
+	libcohost_store_record_t record;
+	size_t base = out->len;
+	const char *tag;
+	int i;
+
+	memset(&record, 0, sizeof(record));
+
+	/* placeholder, filled in once the strings are placed */
+	if (libcohost_buffer_append(out, &record, sizeof(record)) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	record.post_id = post->post_id;
+	record.share_of_post_id = post->share_of_post_id;
+	record.project_id = project->project_id;
+	record.published_at = post->published_at;
+	record.flags = post->flags;
+	record.project_flags = project->flags;
+	record.num_tags = post->num_tags;
+	record.num_comments = post->num_comments;
+	record.headline = record_string(out, base, libcohost_page_string(page, post->headline));
+	record.body = record_string(out, base, libcohost_page_string(page, post->body));
+	record.url = record_string(out, base, libcohost_page_string(page, post->url));
+	record.handle = record_string(out, base, libcohost_intern_string(project->handle));
+	record.display_name = record_string(out, base, libcohost_intern_string(project->display_name));
+	record.avatar_url = record_string(out, base, libcohost_intern_string(project->avatar_url));
+
+	/* tags back to back, empty ones keep their terminator */
+	record.tags = (uint32_t)(out->len - base);
+	for (i = 0; i < post->num_tags; i++)
+	{
+		tag = libcohost_intern_string(page->tags[post->first_tag + i]);
+		if (libcohost_buffer_append(out, tag, strlen(tag) + 1) != LIBCOHOST_RESULT_OK)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	if (libcohost_buffer_append(out, zeros, (RECORD_ALIGN - (out->len - base) % RECORD_ALIGN) % RECORD_ALIGN) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	record.size = (uint32_t)(out->len - base);
+	memcpy(out->data + base, &record, sizeof(record));
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* write a fresh header to an empty data file */
+static int store_create(int fd, uint64_t generation)
+{
+	data_header_t header;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = DATA_MAGIC;
+	header.version = STORE_VERSION;
+	header.generation = generation;
+	header.committed = sizeof(header);
+	header.record_size = sizeof(libcohost_store_record_t);
+
+	if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header) || fsync(fd) != 0)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* commit only the whole records left in a data file cut short of its commit marker */
+/* the timeline survives if all of it is still there */
+static int store_repair(int fd, data_header_t *header, uint64_t size)
+{
+	libcohost_store_record_t record;
+	uint64_t offset, records, timeline = UINT64_MAX;
+
+	offset = sizeof(data_header_t);
+	for (records = 0; records < header->records; records++)
+	{
+		if (offset == header->timeline_offset)
+			timeline = records;
+
+		if (offset + sizeof(record) > size || pread(fd, &record, sizeof(record), offset) != sizeof(record))
+			break;
+		if (record.size < sizeof(record) || record.size % RECORD_ALIGN || offset + record.size > size)
+			break;
+
+		offset += record.size;
+	}
+
+	if (timeline > records || records - timeline < header->timeline_count)
+	{
+		header->timeline_offset = sizeof(data_header_t);
+		header->timeline_count = 0;
+	}
+
+	header->committed = offset;
+	header->records = records;
+
+	if (pwrite(fd, header, sizeof(data_header_t), 0) != sizeof(data_header_t) || fsync(fd) != 0)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* open or create the store in directory path */
+libcohost_store_t *libcohost_store_open(const char *path)
+{
+	libcohost_store_t *store;
+	data_header_t header;
+	char file[1024];
+	struct stat st;
+	size_t len;
+
+	if (path == NULL)
+		return NULL;
+
+	if (mkdir(path, 0755) != 0 && errno != EEXIST)
+		return NULL;
+
+	store = calloc(1, sizeof(libcohost_store_t));
+	if (store == NULL)
+		return NULL;
+
+	len = strlen(path);
+	store->path = malloc(len + 1);
+	if (store->path == NULL)
+	{
+		free(store);
+		return NULL;
+	}
+	memcpy(store->path, path, len + 1);
+	store->fd = -1;
+
+	store_path(store, file, sizeof(file), DATA_NAME);
+	store->fd = open(file, O_RDWR | O_CREAT, 0644);
+	if (store->fd < 0)
+		goto fail;
+
+	if (fstat(store->fd, &st) != 0)
+		goto fail;
+
+	if ((size_t)st.st_size < sizeof(header) && store_create(store->fd, 1) != LIBCOHOST_RESULT_OK)
+		goto fail;
+
+	if (pread(store->fd, &header, sizeof(header), 0) != sizeof(header))
+		goto fail;
+
+	if (header.magic != DATA_MAGIC || header.version != STORE_VERSION || header.record_size != sizeof(libcohost_store_record_t))
+		goto fail;
+
+	if (header.committed < sizeof(header))
+		goto fail;
+
+	/* a file cut short would fault when read past its end through the mapping */
+	if (header.committed > (uint64_t)st.st_size && store_repair(store->fd, &header, st.st_size) != LIBCOHOST_RESULT_OK)
+		goto fail;
+
+	/* drop whatever a crash left behind the commit marker */
+	if ((uint64_t)st.st_size > header.committed && ftruncate(store->fd, header.committed) != 0)
+		goto fail;
+
+	if (store_map_data(store) != LIBCOHOST_RESULT_OK)
+		goto fail;
+
+	store->stats.records = header.records;
+	store->stats.bytes = header.committed;
+
+	if (store_map_index(store) != LIBCOHOST_RESULT_OK && store_index_rebuild(store) != LIBCOHOST_RESULT_OK)
+		goto fail;
+
+	return store;
+
+fail:
+	libcohost_store_close(store);
+	return NULL;
+}
+
+/* unmap and close the store */
+void libcohost_store_close(libcohost_store_t *store)
+{
+	if (store == NULL)
+		return;
+
+	if (store->data)
+		munmap(store->data, store->data_size);
+	if (store->index)
+		munmap(store->index, store->index_size);
+	if (store->fd >= 0)
+		close(store->fd);
+
+	free(store->path);
+	free(store);
+}
+
+/* append the posts of a page and make them the last seen timeline */
+int libcohost_store_commit(libcohost_store_t *store, const libcohost_page_t *page)
+{
+	libcohost_buffer_t out;
+	data_header_t header;
+	index_entry_t *entries, *old;
+	uint64_t offset, count, num_old;
+	int i, r = LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	memset(&out, 0, sizeof(out));
+	memcpy(&header, store_header(store), sizeof(header));
+
+	old = store_entries(store, &num_old);
+	entries = malloc((num_old + page->num_posts + 1) * sizeof(index_entry_t));
+	if (entries == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+	if (num_old)
+		memcpy(entries, old, num_old * sizeof(index_entry_t));
+	count = num_old;
+
+	/* serialize the whole page first so it goes out in one write */
+	for (i = 0; i < page->num_posts; i++)
+	{
+		offset = out.len;
+		if (record_build(&out, page, &page->posts[i]) != LIBCOHOST_RESULT_OK)
+			goto done;
+
+		entries[count].post_id = page->posts[i].post_id;
+		entries[count].size = (uint32_t)(out.len - offset);
+		entries[count].offset = header.committed + offset;
+		count++;
+	}
+
+	r = LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	/* records first, then the header that commits them */
+	if (out.len && pwrite(store->fd, out.data, out.len, header.committed) != (ssize_t)out.len)
+		goto done;
+	if (fsync(store->fd) != 0)
+		goto done;
+
+	header.timeline_offset = header.committed;
+	header.timeline_count = (uint32_t)page->num_posts;
+	header.committed += out.len;
+	header.records += page->num_posts;
+
+	if (pwrite(store->fd, &header, sizeof(header), 0) != sizeof(header) || fsync(store->fd) != 0)
+		goto done;
+
+	if (store_map_data(store) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	store->stats.records = header.records;
+	store->stats.bytes = header.committed;
+	store->stats.commits++;
+
+	/* a stale index is rebuilt on open, so failing here loses nothing */
+	r = store_index_write(store, entries, entries_settle(entries, count));
+
+done:
+	libcohost_buffer_free(&out);
+	free(entries);
+
+	return r;
+}
+
+/* decode the last seen timeline into an empty page, no json involved */
+int libcohost_store_load(libcohost_store_t *store, libcohost_page_t *page)
+{
+	const libcohost_store_record_t *record;
+	libcohost_project_t project;
+	libcohost_post_t *post;
+	const char *tag;
+	uint64_t offset;
+	uint32_t i;
+	int j;
+
+	offset = store_header(store)->timeline_offset;
+
+	for (i = 0; i < store_header(store)->timeline_count; i++, offset += record->size)
+	{
+		record = store_record(store, offset);
+		if (record == NULL)
+			return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+		memset(&project, 0, sizeof(project));
+		project.project_id = record->project_id;
+		project.flags = record->project_flags;
+		project.handle = libcohost_intern(libcohost_store_string(record, record->handle), strlen(libcohost_store_string(record, record->handle)));
+		project.display_name = libcohost_intern(libcohost_store_string(record, record->display_name), strlen(libcohost_store_string(record, record->display_name)));
+		project.avatar_url = libcohost_intern(libcohost_store_string(record, record->avatar_url), strlen(libcohost_store_string(record, record->avatar_url)));
+
+		post = libcohost_page_post_new(page, &project,
+			libcohost_store_string(record, record->headline),
+			libcohost_store_string(record, record->body),
+			libcohost_store_string(record, record->url));
+		if (post == NULL)
+			return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+		post->post_id = record->post_id;
+		post->share_of_post_id = record->share_of_post_id;
+		post->published_at = record->published_at;
+		post->num_comments = record->num_comments;
+		post->flags = record->flags;
+
+		tag = (const char *)record + record->tags;
+		for (j = 0; j < record->num_tags; j++, tag += strlen(tag) + 1)
+			if (libcohost_page_tag_add(page, post, libcohost_intern(tag, strlen(tag))) != LIBCOHOST_RESULT_OK)
+				return LIBCOHOST_RESULT_ALLOC_FAIL;
+	}
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* find the newest record of a post, NULL if it isn't stored */
+const libcohost_store_record_t *libcohost_store_find(libcohost_store_t *store, uint32_t post_id)
+{
+	index_entry_t *entries;
+	uint64_t lo, hi, mid, count;
+
+	entries = store_entries(store, &count);
+
+	/* binary search over the mapped index */
+	lo = 0;
+	hi = count;
+	while (lo < hi)
+	{
+		mid = lo + (hi - lo) / 2;
+		if (entries[mid].post_id < post_id)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo == count || entries[lo].post_id != post_id)
+		return NULL;
+
+	return store_record(store, entries[lo].offset);
+}
+
+/* get a string of a record */
+const char *libcohost_store_string(const libcohost_store_record_t *record, uint32_t offset)
+{
+	return offset ? (const char *)record + offset : "";
+}
+
+/* rewrite the data file with only the newest record of each post */
+int libcohost_store_compact(libcohost_store_t *store)
+{
+	const libcohost_store_record_t *record;
+	char path[1024], tmp[1024];
+	data_header_t header;
+	index_entry_t *entries, *live;
+	uint64_t i, count, num_live, offset, timeline_end, out;
+	int fd, r = LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	memcpy(&header, store_header(store), sizeof(header));
+	live = store_entries(store, &num_live);
+
+	entries = malloc((num_live + header.timeline_count + 1) * sizeof(index_entry_t));
+	if (entries == NULL)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	store_path(store, path, sizeof(path), DATA_NAME);
+	store_path(store, tmp, sizeof(tmp), DATA_NAME ".tmp");
+
+	fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		free(entries);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	out = sizeof(data_header_t);
+	count = 0;
+
+	/* the timeline goes first and stays contiguous */
+	offset = header.timeline_offset;
+	for (i = 0; i < header.timeline_count; i++, offset += record->size)
+	{
+		record = store_record(store, offset);
+		if (record == NULL || pwrite(fd, record, record->size, out) != (ssize_t)record->size)
+			goto done;
+
+		entries[count].post_id = record->post_id;
+		entries[count].size = record->size;
+		entries[count].offset = out;
+		count++;
+		out += record->size;
+	}
+	timeline_end = offset;
+
+	/* then every other post, newest record only */
+	for (i = 0; i < num_live; i++)
+	{
+		if (live[i].offset >= header.timeline_offset && live[i].offset < timeline_end)
+			continue;
+
+		record = store_record(store, live[i].offset);
+		if (record == NULL || pwrite(fd, record, record->size, out) != (ssize_t)record->size)
+			goto done;
+
+		entries[count].post_id = record->post_id;
+		entries[count].size = record->size;
+		entries[count].offset = out;
+		count++;
+		out += record->size;
+	}
+
+	header.generation++;
+	header.committed = out;
+	header.records = count;
+	header.timeline_offset = sizeof(data_header_t);
+
+	if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header) || fsync(fd) != 0)
+		goto done;
+
+	/* the rename is the commit, an index left from before gets rebuilt on open */
+	if (rename(tmp, path) != 0)
+		goto done;
+
+	close(store->fd);
+	store->fd = fd;
+	fd = -1;
+
+	if (store_map_data(store) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	store->stats.records = header.records;
+	store->stats.bytes = header.committed;
+	store->stats.compactions++;
+
+	r = store_index_write(store, entries, entries_settle(entries, count));
+
+done:
+	if (fd >= 0)
+	{
+		close(fd);
+		remove(tmp);
+	}
+	free(entries);
+
+	return r;
+}
+
+/* copy out the store counters */
+void libcohost_store_stats(libcohost_store_t *store, libcohost_store_stats_t *stats)
+{
+	memcpy(stats, &store->stats, sizeof(libcohost_store_stats_t));
+}
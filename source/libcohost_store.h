@@ -0,0 +1,123 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_STORE_H_
+#define _LIBCOHOST_STORE_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+#include "libcohost_post.h"
+
+/* fixed part of a stored post, its strings follow it in the data file */
+/* string fields are offsets from the start of the record, 0 is empty */
+typedef struct libcohost_store_record_t {
+	uint32_t size; /* record and strings, padded to 8 bytes */
+	uint32_t post_id;
+	uint32_t share_of_post_id;
+	uint32_t project_id;
+	int64_t published_at;
+	uint32_t flags;
+	uint32_t project_flags;
+	uint16_t num_tags;
+	uint16_t num_comments;
+	uint32_t headline;
+	uint32_t body;
+	uint32_t url;
+	uint32_t handle;
+	uint32_t display_name;
+	uint32_t avatar_url;
+	uint32_t tags; /* num_tags strings back to back */
+} libcohost_store_record_t;
+
+/* store counters */
+typedef struct libcohost_store_stats_t {
+	unsigned long records;
+	unsigned long live_records;
+	unsigned long bytes;
+	unsigned long live_bytes;
+	unsigned long commits;
+	unsigned long compactions;
+	unsigned long index_rebuilds;
+} libcohost_store_stats_t;
+
+/* post store, an append-only data file and a sorted id index, both mapped */
+typedef struct libcohost_store_t {
+	char *path;
+	int fd;
+	void *data;
+	size_t data_size;
+	void *index;
+	size_t index_size;
+	libcohost_store_stats_t stats;
+} libcohost_store_t;
+
+/* open or create the store in directory path */
+/* anything written after the last commit marker is discarded */
+/* returns NULL on failure */
+libcohost_store_t *libcohost_store_open(const char *path);
+
+/* unmap and close the store */
+void libcohost_store_close(libcohost_store_t *store);
+
+/* append the posts of a page and make them the last seen timeline */
+/* the page is durable once this returns LIBCOHOST_RESULT_OK */
+int libcohost_store_commit(libcohost_store_t *store, const libcohost_page_t *page);
+
+/* decode the last seen timeline into an empty page, no json involved */
+int libcohost_store_load(libcohost_store_t *store, libcohost_page_t *page);
+
+/* find the newest record of a post, NULL if it isn't stored */
+/* records stay valid until the next commit or compaction */
+const libcohost_store_record_t *libcohost_store_find(libcohost_store_t *store, uint32_t post_id);
+
+/* get a string of a record */
+const char *libcohost_store_string(const libcohost_store_record_t *record, uint32_t offset);
+
+/* rewrite the data file with only the newest record of each post */
+int libcohost_store_compact(libcohost_store_t *store);
+
+/* copy out the store counters */
+void libcohost_store_stats(libcohost_store_t *store, libcohost_store_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_STORE_H_ */
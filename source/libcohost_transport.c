@@ -0,0 +1,291 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "libcohost_transport.h"
+
+/* recording identification */
+#define RECORD_MAGIC (0x43524843) /* "CHRC" */
+#define RECORD_VERSION (1)
+#define RECORD_EXT ".rec"
+
+/* recording header, followed by the target, head and body */
+typedef struct record_header_t {
+	uint32_t magic;
+	uint32_t version;
+	int32_t status;
+	uint32_t target_len;
+	uint32_t head_len;
+	uint32_t body_len;
+} record_header_t;
+
+/* transport set by libcohost_transport_use() */
+static libcohost_transport_t *current;
+
+/* build the file name of the recording of target */
+static void record_name(libcohost_transport_t *transport, const char *target, char *out, size_t len)
+{
+	uint64_t hash = libcohost_hash(target, strlen(target), LIBCOHOST_HASH_SEED);
+
+	snprintf(out, len, "%s/%08lx%08lx" RECORD_EXT, transport->path,
+		(unsigned long)(hash >> 32), (unsigned long)(hash & 0xFFFFFFFF));
+}
+
+/* read len bytes into a buffer */
+static int record_read(FILE *file, libcohost_buffer_t *buffer, size_t len)
+{
+	libcohost_buffer_reset(buffer);
+
+	if (libcohost_buffer_reserve(buffer, len + 1) != LIBCOHOST_RESULT_OK)
+		return LIBCOHOST_RESULT_ALLOC_FAIL;
+
+	if (len && fread(buffer->data, 1, len, file) != len)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	/* keep it a string, head lookups depend on that */
+	buffer->data[len] = '\0';
+	buffer->len = len;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* open a transport keeping its recordings in directory path */
+libcohost_transport_t *libcohost_transport_open(const char *path, int mode)
+{
+	libcohost_transport_t *transport;
+	size_t len;
+
+	if (path == NULL && mode != LIBCOHOST_TRANSPORT_NETWORK)
+		return NULL;
+
+	if (mode == LIBCOHOST_TRANSPORT_RECORD && mkdir(path, 0755) != 0 && errno != EEXIST)
+		return NULL;
+
+	transport = calloc(1, sizeof(libcohost_transport_t));
+	if (transport == NULL)
+		return NULL;
+
+	if (path)
+	{
+		len = strlen(path);
+		transport->path = malloc(len + 1);
+		if (transport->path == NULL)
+		{
+			free(transport);
+			return NULL;
+		}
+		memcpy(transport->path, path, len + 1);
+	}
+
+	transport->mode = mode;
+
+	return transport;
+}
+
+/* free a transport */
+void libcohost_transport_close(libcohost_transport_t *transport)
+{
+	if (transport == NULL)
+		return;
+
+	if (current == transport)
+		current = NULL;
+
+	free(transport->path);
+	free(transport);
+}
+
+/* send requests to origin instead of the api host */
+int libcohost_transport_origin_set(libcohost_transport_t *transport, const char *origin)
+{
+	size_t len = origin ? strlen(origin) : 0;
+
+	if (len >= sizeof(transport->origin))
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	/* the target brings its own slash */
+	while (len && origin[len - 1] == '/')
+		len--;
+
+	memcpy(transport->origin, origin ? origin : "", len);
+	transport->origin[len] = '\0';
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* route the requests of every session through transport, NULL for the plain network */
+void libcohost_transport_use(libcohost_transport_t *transport)
+{
+	current = transport;
+}
+
+/* get the transport set by libcohost_transport_use() */
+libcohost_transport_t *libcohost_transport_current(void)
+{
+	return current;
+}
+
+/* get the path and query of a url, or the url itself if it is one already */
+const char *libcohost_transport_target(const char *url)
+{
+	const char *p = strstr(url, "://");
+	const char *slash;
+
+	if (p == NULL)
+		return url;
+
+	slash = strchr(p + 3, '/');
+
+	return slash ? slash : "/";
+}
+
+/* write the url to actually fetch into out */
+int libcohost_transport_rewrite(libcohost_transport_t *transport, const char *url, char *out, size_t len)
+{
+	if (transport == NULL || transport->origin[0] == '\0')
+		return 0;
+
+	if ((size_t)snprintf(out, len, "%s%s", transport->origin, libcohost_transport_target(url)) >= len)
+		return 0;
+
+	return 1;
+}
+
+/* save the response to url */
+int libcohost_transport_save(libcohost_transport_t *transport, const char *url, long status, const libcohost_buffer_t *head, const libcohost_buffer_t *body)
+{
+	char name[1024], temp[1040];
+	record_header_t header;
+	const char *target = libcohost_transport_target(url);
+	FILE *file;
+	int ok;
+
+	if (transport->path == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	header.magic = RECORD_MAGIC;
+	header.version = RECORD_VERSION;
+	header.status = (int32_t)status;
+	header.target_len = (uint32_t)strlen(target);
+	header.head_len = (uint32_t)head->len;
+	header.body_len = (uint32_t)body->len;
+
+	/* written aside and renamed, a reader never sees half a recording */
+	record_name(transport, target, name, sizeof(name));
+	snprintf(temp, sizeof(temp), "%s.tmp", name);
+
+	file = fopen(temp, "wb");
+	if (file == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(target, 1, header.target_len, file) == header.target_len;
+	ok = ok && (head->len == 0 || fwrite(head->data, 1, head->len, file) == head->len);
+	ok = ok && (body->len == 0 || fwrite(body->data, 1, body->len, file) == body->len);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok || rename(temp, name) != 0)
+	{
+		remove(temp);
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	transport->stats.recorded++;
+
+	return LIBCOHOST_RESULT_OK;
+}
+
+/* load the saved response to url into head and body */
+int libcohost_transport_load(libcohost_transport_t *transport, const char *url, long *status, libcohost_buffer_t *head, libcohost_buffer_t *body)
+{
+	char name[1024], stored[1024];
+	record_header_t header;
+	const char *target = libcohost_transport_target(url);
+	FILE *file;
+	int r = LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	if (transport->path == NULL)
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+
+	record_name(transport, target, name, sizeof(name));
+
+	file = fopen(name, "rb");
+	if (file == NULL)
+	{
+		transport->stats.missing++;
+		return LIBCOHOST_RESULT_GENERAL_FAIL;
+	}
+
+	/* the stored target rules out hash collisions */
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+		header.magic != RECORD_MAGIC || header.version != RECORD_VERSION ||
+		header.target_len >= sizeof(stored) ||
+		fread(stored, 1, header.target_len, file) != header.target_len)
+		goto done;
+
+	stored[header.target_len] = '\0';
+	if (strcmp(stored, target) != 0)
+		goto done;
+
+	if (record_read(file, head, header.head_len) != LIBCOHOST_RESULT_OK ||
+		record_read(file, body, header.body_len) != LIBCOHOST_RESULT_OK)
+		goto done;
+
+	*status = header.status;
+	transport->stats.replayed++;
+	r = LIBCOHOST_RESULT_OK;
+
+done:
+	if (r != LIBCOHOST_RESULT_OK)
+		transport->stats.missing++;
+	fclose(file);
+	return r;
+}
+
+/* copy out the transport counters */
+void libcohost_transport_stats(libcohost_transport_t *transport, libcohost_transport_stats_t *stats)
+{
+	memcpy(stats, &transport->stats, sizeof(libcohost_transport_stats_t));
+}
@@ -0,0 +1,110 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef _LIBCOHOST_TRANSPORT_H_
+#define _LIBCOHOST_TRANSPORT_H_
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "libcohost.h"
+
+/* longest origin a transport can redirect requests to */
+#define LIBCOHOST_TRANSPORT_ORIGIN_LEN (128)
+
+/* what a transport does with requests */
+enum {
+	LIBCOHOST_TRANSPORT_NETWORK, /* plain network, optionally redirected */
+	LIBCOHOST_TRANSPORT_RECORD, /* network, saving every final response, streamed ones too */
+	LIBCOHOST_TRANSPORT_REPLAY /* saved responses served in process, no sockets */
+};
+
+/* transport counters */
+typedef struct libcohost_transport_stats_t {
+	unsigned long recorded;
+	unsigned long replayed;
+	unsigned long missing; /* replays without a recording */
+} libcohost_transport_stats_t;
+
+/* where requests go, recordings are keyed by url path and query */
+typedef struct libcohost_transport_t {
+	int mode;
+	char *path;
+	char origin[LIBCOHOST_TRANSPORT_ORIGIN_LEN]; /* replaces scheme and host, empty for none */
+	libcohost_transport_stats_t stats;
+} libcohost_transport_t;
+
+/* open a transport keeping its recordings in directory path */
+/* path may be NULL in network mode, returns NULL on failure */
+libcohost_transport_t *libcohost_transport_open(const char *path, int mode);
+
+/* free a transport */
+void libcohost_transport_close(libcohost_transport_t *transport);
+
+/* send requests to origin, like "http://127.0.0.1:8080", instead of the api host */
+int libcohost_transport_origin_set(libcohost_transport_t *transport, const char *origin);
+
+/* route the requests of every session through transport, NULL for the plain network */
+/* set it before creating sessions and starting worker threads */
+void libcohost_transport_use(libcohost_transport_t *transport);
+
+/* get the transport set by libcohost_transport_use() */
+libcohost_transport_t *libcohost_transport_current(void);
+
+/* get the path and query of a url, or the url itself if it is one already */
+const char *libcohost_transport_target(const char *url);
+
+/* write the url to actually fetch into out */
+/* returns 0 if url can be used as it is */
+int libcohost_transport_rewrite(libcohost_transport_t *transport, const char *url, char *out, size_t len);
+
+/* save the response to url */
+int libcohost_transport_save(libcohost_transport_t *transport, const char *url, long status, const libcohost_buffer_t *head, const libcohost_buffer_t *body);
+
+/* load the saved response to url into head and body */
+/* returns LIBCOHOST_RESULT_GENERAL_FAIL if there is none */
+int libcohost_transport_load(libcohost_transport_t *transport, const char *url, long *status, libcohost_buffer_t *head, libcohost_buffer_t *body);
+
+/* copy out the transport counters */
+void libcohost_transport_stats(libcohost_transport_t *transport, libcohost_transport_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _LIBCOHOST_TRANSPORT_H_ */
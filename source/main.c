@@ -40,8 +40,15 @@ SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include "libcohost.h"
+#include "libcohost_post.h"
+#include "libcohost_store.h"
+#include "libcohost_pager.h"
+#include "libcohost_limit.h"
+#include "libcohost_cache.h"
+#include "libcohost_transport.h"
 
 #include "eui_sdl2.h"
 #include "palette_vga.h"
@@ -64,6 +71,39 @@ SOFTWARE.
 
 #define UNUSED(x) ((void)(x))
 
+/* decoded posts are kept here between runs */
+#define STORE_PATH "choster.store"
+
+/* the timeline on screen at quit, restored before any network i/o */
+#define SNAPSHOT_PATH "choster.snapshot"
+#define SNAPSHOT_MAGIC (0x53534843) /* CHSS */
+#define SNAPSHOT_VERSION (2)
+
+/* pages past the first are prefetched within this much memory */
+#define PAGER_BUDGET (4 * 1024 * 1024)
+#define MAX_PAGES (64)
+
+/* stay under the server's rate limit while prefetching */
+#define LIMIT_RATE (8.0)
+#define LIMIT_BURST (8)
+
+/* responses are kept on disk and served for a minute without asking again */
+#define CACHE_PATH "choster.cache"
+#define CACHE_BYTES (16 * 1024 * 1024)
+#define CACHE_FRESH (60)
+
+/* height of a post in the timeline */
+#define ROW_HEIGHT (40)
+
+/* set this in the environment to report startup times */
+#define TIMING_ENV "CHOSTER_TIMING"
+
+/* set these to a directory to record or replay api responses, */
+/* and to a url to send requests to a stand-in server instead */
+#define RECORD_ENV "CHOSTER_RECORD"
+#define REPLAY_ENV "CHOSTER_REPLAY"
+#define ORIGIN_ENV "CHOSTER_ORIGIN"
+
 /*
  *
  * globals
@@ -71,13 +111,41 @@ SOFTWARE.
  */
 
 static libcohost_session_t session;
+static libcohost_page_t *page;
+static libcohost_store_t *store;
+static const char *handle;
+static libcohost_pager_t pager;
+static libcohost_limit_t *limit;
+static libcohost_cache_t *cache;
+static libcohost_transport_t *transport;
+static libcohost_page_t *pages[MAX_PAGES]; /* timeline past the first page */
+static int num_pages;
+static int scroll; /* pixels */
+
+/* snapshot header, the session id is a secret and never written out */
+/* bump the version whenever this or libcohost_post_t changes shape */
+typedef struct snapshot_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t post_size;
+	uint32_t flags;
+	int32_t scroll; /* pixels, rows are fixed height so this is all the layout there is */
+	char handle[64];
+} snapshot_t;
+
+static snapshot_t snapshot;
+
+/* startup timing */
+static int timing;
+static uint64_t timing_start;
+static int timing_frames;
+static int timing_content;
 
 static SDL_Window *window;
 static SDL_Surface *surface8;
 static SDL_Surface *surface32;
 static SDL_Renderer *renderer;
 static SDL_Texture *texture;
-static SDL_Rect rect;
 static SDL_Color colors[256];
 static SDL_Event event;
 
@@ -87,10 +155,46 @@ static SDL_Event event;
  *
  */
 
+void snapshot_save(void);
+
 void quit(int code)
 {
+	libcohost_store_stats_t store_stats;
+
+	int i;
+
+	/* write out what's on screen for the next start */
+	snapshot_save();
+
+	/* the pager's requests go with the session */
+	libcohost_pager_free(&pager);
+	for (i = 0; i < num_pages; i++)
+	{
+		libcohost_page_free(pages[i]);
+		free(pages[i]);
+	}
+
 	/* destroy libcohost session */
 	libcohost_session_destroy(&session);
+	libcohost_limit_free(limit);
+	libcohost_cache_close(cache);
+	libcohost_transport_close(transport);
+
+	/* free posts */
+	if (page)
+	{
+		libcohost_page_free(page);
+		free(page);
+	}
+
+	/* close post store, compacting it once it's mostly stale records */
+	if (store)
+	{
+		libcohost_store_stats(store, &store_stats);
+		if (store_stats.live_bytes * 2 < store_stats.bytes)
+			libcohost_store_compact(store);
+		libcohost_store_close(store);
+	}
 
 	/* shutdown libcohost */
 	libcohost_quit();
@@ -232,21 +336,321 @@ void gfx_init(void)
 	/* make sure relative mouse mode is disabled */
 	SDL_SetRelativeMouseMode(SDL_FALSE);
 
-	/* setup blit rect */
-	rect.x = 0;
-	rect.y = 0;
-	rect.w = WIDTH;
-	rect.h = HEIGHT;
-
 	/* init eui */
 	eui_init(surface8->w, surface8->h, surface8->format->BitsPerPixel, surface8->pitch, surface8->pixels);
 }
 
+/* keep the decoded page of a finished posts request */
+void posts_done(libcohost_request_t *request, void *user)
+{
+	UNUSED(user);
+
+	if (request->result != LIBCOHOST_RESULT_OK || request->status != 200)
+	{
+		log_debug("libcohost", "couldn't load posts: %s (%ld)", libcohost_result_string(request->result), request->status);
+		return;
+	}
+
+	if (page)
+	{
+		libcohost_page_free(page);
+		free(page);
+	}
+
+	/* take ownership of the page */
+	page = request->page;
+	request->page = NULL;
+
+	log_info("libcohost", "loaded %d posts", page->num_posts);
+
+	/* remember it for the next start */
+	if (store && libcohost_store_commit(store, page) != LIBCOHOST_RESULT_OK)
+		log_debug("libcohost", "couldn't store posts");
+}
+
+/* write session metadata and the current page to the snapshot file */
+void snapshot_save(void)
+{
+	libcohost_buffer_t buffer;
+	FILE *file;
+	int ok;
+
+	if (page == NULL || page->num_posts == 0)
+		return;
+
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.magic = SNAPSHOT_MAGIC;
+	snapshot.version = SNAPSHOT_VERSION;
+	snapshot.post_size = sizeof(libcohost_post_t);
+	snapshot.flags = session.flags;
+	snapshot.scroll = scroll;
+	if (handle)
+		strncpy(snapshot.handle, handle, sizeof(snapshot.handle) - 1);
+
+	memset(&buffer, 0, sizeof(buffer));
+	if (libcohost_buffer_append(&buffer, &snapshot, sizeof(snapshot)) != LIBCOHOST_RESULT_OK ||
+		libcohost_page_save(page, &buffer) != LIBCOHOST_RESULT_OK)
+	{
+		libcohost_buffer_free(&buffer);
+		return;
+	}
+
+	/* write next to the old one and rename, so a crash can't leave half a file */
+	file = fopen(SNAPSHOT_PATH ".tmp", "wb");
+	if (file == NULL)
+	{
+		libcohost_buffer_free(&buffer);
+		return;
+	}
+
+	ok = fwrite(buffer.data, 1, buffer.len, file) == buffer.len;
+	ok = fclose(file) == 0 && ok;
+	if (!ok || rename(SNAPSHOT_PATH ".tmp", SNAPSHOT_PATH) != 0)
+		remove(SNAPSHOT_PATH ".tmp");
+
+	libcohost_buffer_free(&buffer);
+}
+
+/* restore the page of the last session from the snapshot file */
+void snapshot_restore(void)
+{
+	FILE *file;
+	char *data;
+	long len;
+
+	file = fopen(SNAPSHOT_PATH, "rb");
+	if (file == NULL)
+		return;
+
+	/* read the whole thing in one go */
+	data = NULL;
+	if (fseek(file, 0, SEEK_END) == 0 && (len = ftell(file)) > (long)sizeof(snapshot) && fseek(file, 0, SEEK_SET) == 0)
+	{
+		data = malloc(len);
+		if (data && fread(data, 1, len, file) != (size_t)len)
+		{
+			free(data);
+			data = NULL;
+		}
+	}
+
+	fclose(file);
+
+	if (data == NULL)
+		return;
+
+	memcpy(&snapshot, data, sizeof(snapshot));
+	snapshot.handle[sizeof(snapshot.handle) - 1] = '\0';
+
+	if (snapshot.magic != SNAPSHOT_MAGIC || snapshot.version != SNAPSHOT_VERSION ||
+		snapshot.post_size != sizeof(libcohost_post_t))
+	{
+		log_debug("choster", "ignoring stale snapshot %s", SNAPSHOT_PATH);
+		memset(&snapshot, 0, sizeof(snapshot));
+		free(data);
+		return;
+	}
+
+	page = malloc(sizeof(libcohost_page_t));
+	if (page && libcohost_page_init(page) == LIBCOHOST_RESULT_OK &&
+		libcohost_page_restore(page, data + sizeof(snapshot), len - sizeof(snapshot)) != 0)
+	{
+		log_info("choster", "restored %d posts from snapshot", page->num_posts);
+
+		/* only the first page was saved, so stay within it */
+		scroll = snapshot.scroll;
+		if (scroll > page->num_posts * ROW_HEIGHT - HEIGHT + 8)
+			scroll = page->num_posts * ROW_HEIGHT - HEIGHT + 8;
+		if (scroll < 0)
+			scroll = 0;
+	}
+	else if (page)
+	{
+		libcohost_page_free(page);
+		free(page);
+		page = NULL;
+	}
+
+	free(data);
+}
+
+/* pick a transport from the environment */
+void transport_setup(void)
+{
+	const char *origin = getenv(ORIGIN_ENV);
+
+	if (getenv(REPLAY_ENV))
+		transport = libcohost_transport_open(getenv(REPLAY_ENV), LIBCOHOST_TRANSPORT_REPLAY);
+	else if (getenv(RECORD_ENV))
+		transport = libcohost_transport_open(getenv(RECORD_ENV), LIBCOHOST_TRANSPORT_RECORD);
+	else if (origin)
+		transport = libcohost_transport_open(NULL, LIBCOHOST_TRANSPORT_NETWORK);
+	else
+		return;
+
+	if (transport == NULL)
+		log_error("libcohost", "couldn't set up transport");
+
+	if (origin && libcohost_transport_origin_set(transport, origin) != LIBCOHOST_RESULT_OK)
+		log_error("libcohost", "origin %s is too long", origin);
+
+	libcohost_transport_use(transport);
+}
+
+/* show the posts seen last time until the network catches up */
+void posts_restore(void)
+{
+	store = libcohost_store_open(STORE_PATH);
+	if (store == NULL)
+	{
+		log_debug("libcohost", "couldn't open post store %s", STORE_PATH);
+		return;
+	}
+
+	/* the snapshot already has what was on screen */
+	if (page)
+		return;
+
+	page = malloc(sizeof(libcohost_page_t));
+	if (page == NULL)
+		return;
+
+	if (libcohost_page_init(page) != LIBCOHOST_RESULT_OK || libcohost_store_load(store, page) != LIBCOHOST_RESULT_OK)
+		log_debug("libcohost", "couldn't restore posts");
+	else
+		log_info("libcohost", "restored %d posts", page->num_posts);
+}
+
+/* get page i of the timeline, the first one comes from outside the pager */
+libcohost_page_t *timeline_page(int i)
+{
+	return i == 0 ? page : pages[i - 1];
+}
+
+/* number of posts in the timeline */
+int timeline_rows(void)
+{
+	int i, rows;
+
+	rows = page ? page->num_posts : 0;
+	for (i = 0; i < num_pages; i++)
+		rows += pages[i]->num_posts;
+
+	return rows;
+}
+
+/* find the page and index of a timeline row, NULL past the end */
+libcohost_page_t *timeline_row(int row, int *index)
+{
+	libcohost_page_t *p;
+	int i;
+
+	for (i = 0; i <= num_pages; i++)
+	{
+		p = timeline_page(i);
+		if (p == NULL)
+			continue;
+
+		if (row < p->num_posts)
+		{
+			*index = row;
+			return p;
+		}
+
+		row -= p->num_posts;
+	}
+
+	return NULL;
+}
+
+/* scroll with the mouse wheel */
+void timeline_event(SDL_Event *e)
+{
+	int max;
+
+	if (e->type != SDL_MOUSEWHEEL)
+		return;
+
+	scroll -= e->wheel.y * ROW_HEIGHT;
+
+	max = timeline_rows() * ROW_HEIGHT - HEIGHT + 8;
+	if (scroll > max)
+		scroll = max;
+	if (scroll < 0)
+		scroll = 0;
+}
+
+/* tell the pager where the reader is and pick up pages as they're reached */
+void timeline_update(void)
+{
+	libcohost_page_t *p;
+	double position;
+	int row, index, i;
+
+	if (pager.session == NULL || page == NULL || page->num_posts == 0)
+		return;
+
+	/* position in pages, fractional within the page at the top */
+	row = scroll / ROW_HEIGHT;
+	position = 1 + num_pages;
+	for (i = 0; i <= num_pages; i++)
+	{
+		p = timeline_page(i);
+		if (row < p->num_posts)
+		{
+			position = i + (double)row / p->num_posts;
+			break;
+		}
+
+		row -= p->num_posts;
+	}
+
+	libcohost_pager_scroll(&pager, position, SDL_GetTicks());
+
+	/* append the next page once less than a screen of posts is left */
+	row = (scroll + 2 * HEIGHT) / ROW_HEIGHT;
+	if (num_pages < MAX_PAGES && timeline_row(row, &index) == NULL)
+	{
+		p = libcohost_pager_take(&pager, num_pages + 1);
+		if (p)
+			pages[num_pages++] = p;
+	}
+}
+
+/* draw a column of post headlines */
+void gfx_posts(void)
+{
+	libcohost_page_t *p;
+	libcohost_post_t *post;
+	libcohost_project_t *project;
+	int row, index, y;
+
+	eui_frame_align_set(EUI_ALIGN_START, EUI_ALIGN_START);
+
+	row = scroll / ROW_HEIGHT;
+	for (y = 8 - scroll % ROW_HEIGHT; y < HEIGHT && (p = timeline_row(row, &index)) != NULL; row++, y += ROW_HEIGHT)
+	{
+		post = &p->posts[index];
+		project = &p->projects[post->project];
+
+		eui_draw_box(8, y, WIDTH - 16, ROW_HEIGHT - 8, 0x0F);
+		eui_draw_text(16, y + 4, 0x01, (char *)libcohost_intern_string(project->handle));
+		eui_draw_text(16, y + 18, 0x00, (char *)libcohost_page_string(p, post->headline));
+	}
+}
+
 void gfx_main(void)
 {
 	/* clear screen */
 	eui_screen_clear(0x01);
 
+	/* show posts once they've arrived */
+	if (page && page->num_posts)
+	{
+		gfx_posts();
+		return;
+	}
+
 	/* set alignment to the center of the frame */
 	eui_frame_align_set(EUI_ALIGN_MIDDLE, EUI_ALIGN_MIDDLE);
 
@@ -267,6 +671,61 @@ void gfx_main(void)
 	eui_frame_pop();
 }
 
+/* milliseconds since startup */
+double timing_now(void)
+{
+	return (double)(SDL_GetPerformanceCounter() - timing_start) * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+/* draw and present one frame */
+void gfx_frame(void)
+{
+	const eui_rect_t *dirty;
+	SDL_Rect rect;
+	int num_dirty, i;
+
+	/* run eui context, it only redraws what changed since the last one */
+	if (eui_context_begin())
+	{
+		/* do main program */
+		gfx_main();
+
+		/* end eui context */
+		eui_context_end();
+	}
+
+	/* copy what changed to screen */
+	num_dirty = eui_context_dirty_get(&dirty);
+	for (i = 0; i < num_dirty; i++)
+	{
+		rect.x = dirty[i].x;
+		rect.y = dirty[i].y;
+		rect.w = dirty[i].w;
+		rect.h = dirty[i].h;
+		SDL_BlitSurface(surface8, &rect, surface32, &rect);
+		SDL_UpdateTexture(texture, &rect,
+			(unsigned char *)surface32->pixels + rect.y * surface32->pitch + rect.x * surface32->format->BytesPerPixel,
+			surface32->pitch);
+	}
+
+	SDL_RenderClear(renderer);
+	SDL_RenderCopy(renderer, texture, NULL, NULL);
+	SDL_RenderPresent(renderer);
+
+	/* report startup milestones */
+	if (!timing)
+		return;
+
+	if (timing_frames++ == 0)
+		log_info("choster", "first frame after %.2f ms", timing_now());
+
+	if (!timing_content && page && page->num_posts)
+	{
+		timing_content = 1;
+		log_info("choster", "first content after %.2f ms (%s)", timing_now(), timing_frames == 1 ? "restored" : "network");
+	}
+}
+
 /*
  *
  * main
@@ -275,6 +734,10 @@ void gfx_main(void)
 
 int main(int argc, char **argv)
 {
+	libcohost_intern_stats_t intern_stats;
+	libcohost_pager_stats_t pager_stats;
+	libcohost_limit_stats_t limit_stats;
+	libcohost_cache_stats_t cache_stats;
 	int r;
 
 	UNUSED(argc);
@@ -282,8 +745,13 @@ int main(int argc, char **argv)
 
 	print_banner();
 
-	/* check arg count */
-	if (argc != 3)
+	/* start the clock before anything else */
+	timing = getenv(TIMING_ENV) != NULL;
+	if (timing)
+		timing_start = SDL_GetPerformanceCounter();
+
+	/* check arg count, an optional project handle follows the credentials */
+	if (argc != 3 && argc != 4)
 		log_error(TITLE, "incorrect number of command line arguments");
 
 	/* startup */
@@ -293,6 +761,23 @@ int main(int argc, char **argv)
 	else
 		log_info("libcohost", "successfully initialized");
 
+	/* route requests through recordings or a stand-in server if asked to */
+	transport_setup();
+
+	/* restore posts before the network gets involved */
+	snapshot_restore();
+	posts_restore();
+
+	/* follow the project from last time unless told otherwise */
+	if (argc == 4)
+		handle = argv[3];
+	else if (snapshot.handle[0])
+		handle = snapshot.handle;
+
+	/* create window and show what we have before logging in */
+	gfx_init();
+	gfx_frame();
+
 	/* create session */
 	r = libcohost_session_new(&session, argv[1], argv[2], NULL);
 	if (r != LIBCOHOST_RESULT_OK)
@@ -300,40 +785,83 @@ int main(int argc, char **argv)
 	else
 		log_info("libcohost", "successfully created session");
 
-	/* create window */
-	gfx_init();
+	/* pace requests, backing off when the server throttles us */
+	limit = libcohost_limit_new(LIMIT_RATE, LIMIT_BURST, LIBCOHOST_MAX_HANDLES);
+	libcohost_session_limit_set(&session, limit);
+
+	/* answer repeat requests from disk, asking the server only when they go stale */
+	cache = libcohost_cache_open(CACHE_PATH, CACHE_BYTES, CACHE_FRESH);
+	if (cache == NULL)
+		log_debug("libcohost", "couldn't open response cache %s", CACHE_PATH);
+	libcohost_session_cache_set(&session, cache);
+
+	/* keep network stalls off the render thread */
+	r = libcohost_worker_start(&session);
+	if (r != LIBCOHOST_RESULT_OK)
+		log_error("libcohost", libcohost_result_string(r));
+
+	/* fetch the first page of posts, the pager brings in the rest */
+	if (handle && libcohost_project_posts(&session, handle, 0, posts_done, NULL) == NULL)
+		log_error("libcohost", "couldn't request posts of %s", handle);
+	if (handle && libcohost_pager_init(&pager, &session, handle, 1, PAGER_BUDGET) != LIBCOHOST_RESULT_OK)
+		log_error("libcohost", "couldn't page through posts of %s", handle);
 
 	/* main loop */
 	while (!SDL_QuitRequested())
 	{
 		/* push events */
 		while (SDL_PollEvent(&event))
+		{
+			timeline_event(&event);
 			eui_sdl2_event_push(&event);
+		}
 
 		/* process events */
 		eui_event_queue_process();
 
-		/* clear screen */
-		SDL_FillRect(surface8, NULL, 0x00);
+		/* fire callbacks of finished network requests */
+		libcohost_poll(&session, 0);
 
-		/* run eui context */
-		if (eui_context_begin())
-		{
-			/* do main program */
-			gfx_main();
+		/* prefetch ahead of the reader */
+		timeline_update();
 
-			/* end eui context */
-			eui_context_end();
-		}
+		/* draw */
+		gfx_frame();
+	}
 
-		/* copy to screen */
-		SDL_BlitSurface(surface8, &rect, surface32, &rect);
-		SDL_UpdateTexture(texture, NULL, surface32->pixels, surface32->pitch);
-		SDL_RenderClear(renderer);
-		SDL_RenderCopy(renderer, texture, NULL, NULL);
-		SDL_RenderPresent(renderer);
+	/* the worker updates the counters below until it is stopped */
+	libcohost_worker_stop(&session);
+
+	/* report how much repeated strings were deduplicated */
+	libcohost_intern_stats(&intern_stats);
+	log_debug("libcohost", "interned %lu strings in %lu bytes, %lu bytes requested",
+		intern_stats.strings, intern_stats.bytes, intern_stats.bytes_requested);
+
+	/* report how many requests rode on another's transfer */
+	log_debug("libcohost", "%lu requests, %lu coalesced", session.stats.requests, session.stats.coalesced);
+
+	/* report throttling and time spent queued */
+	if (limit)
+	{
+		libcohost_limit_stats(limit, &limit_stats);
+		log_debug("libcohost", "limiter: %lu started, %lu throttled, %lu retries, window %.1f, queued %lu us on average, %lu us at most",
+			limit_stats.started, limit_stats.throttled, limit_stats.retries, limit_stats.window,
+			limit_stats.started ? limit_stats.wait_us / limit_stats.started : 0, limit_stats.wait_max_us);
 	}
 
+	/* report how often the network was skipped */
+	if (cache)
+	{
+		libcohost_cache_stats(cache, &cache_stats);
+		log_debug("libcohost", "cache: %lu hits, %lu misses, %lu revalidated, %lu bytes held",
+			cache_stats.hits, cache_stats.misses, cache_stats.revalidated, cache_stats.bytes);
+	}
+
+	/* report how well prefetching kept up */
+	libcohost_pager_stats(&pager, &pager_stats);
+	log_debug("libcohost", "pager: %lu hits, %lu misses, %lu of %lu bytes wasted, %lu bytes peak",
+		pager_stats.hits, pager_stats.misses, pager_stats.wasted_bytes, pager_stats.fetched_bytes, pager_stats.peak_bytes);
+
 	/* shutdown */
 	quit(EXIT_SUCCESS);
 
@@ -0,0 +1,318 @@
+/*
+ANTI-CAPITALIST SOFTWARE LICENSE (v 1.4)
+
+Copyright (c) 2022-2024 erysdren (it/she/they)
+
+This is anti-capitalist software, released for free use by individuals
+and organizations that do not operate by capitalist principles.
+
+Permission is hereby granted, free of charge, to any person or
+organization (the "User") obtaining a copy of this software and
+associated documentation files (the "Software"), to use, copy, modify,
+merge, distribute, and/or sell copies of the Software, subject to the
+following conditions:
+
+  1. The above copyright notice and this permission notice shall be
+  included in all copies or modified versions of the Software.
+
+  2. The User is one of the following:
+    a. An individual person, laboring for themselves
+    b. A non-profit organization
+    c. An educational institution
+    d. An organization that seeks shared profit for all of its members,
+    and allows non-members to set the cost of their labor
+
+  3. If the User is an organization with owners, then all owners are
+  workers and all workers are owners with equal equity and/or equal vote.
+
+  4. If the User is an organization, then the User is not law enforcement
+  or military, or working for or under either.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+ANY KIND, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+ * stand-in for the cohost api, serving responses saved by a recording
+ * libcohost transport over plain http on the loopback interface
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "libcohost.h"
+#include "libcohost_transport.h"
+
+#define NAME "choster-serve"
+
+/* request heads longer than this are refused */
+#define REQUEST_MAX (8192)
+
+/* bandwidth is metered out in slices this long */
+#define SLICE_US (10000)
+
+/* options */
+static libcohost_transport_t *transport;
+static unsigned long latency_ms;
+static unsigned long bandwidth; /* bytes per second, 0 for unlimited */
+static int verbose;
+
+/* recordings are read from several threads */
+static pthread_mutex_t transport_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* write all of len, metered to the configured bandwidth */
+static int send_all(int fd, const char *data, size_t len)
+{
+	size_t slice, chunk;
+	ssize_t n;
+
+	slice = bandwidth ? bandwidth / (1000000 / SLICE_US) : len;
+	if (slice == 0)
+		slice = 1;
+
+	while (len)
+	{
+		chunk = len < slice ? len : slice;
+
+		n = send(fd, data, chunk, MSG_NOSIGNAL);
+		if (n <= 0)
+			return 0;
+
+		data += n;
+		len -= n;
+
+		if (bandwidth && len)
+			usleep(SLICE_US);
+	}
+
+	return 1;
+}
+
+/* recorded headers that describe the original transfer rather than the body */
+static int header_skip(const char *line, size_t len)
+{
+	static const char *skip[] = {"content-length:", "content-encoding:", "transfer-encoding:", "connection:", "keep-alive:"};
+	size_t i, n;
+
+	/* status lines and blank lines */
+	if (memchr(line, ':', len) == NULL)
+		return 1;
+
+	for (i = 0; i < sizeof(skip) / sizeof(skip[0]); i++)
+	{
+		n = strlen(skip[i]);
+		if (len >= n && strncasecmp(line, skip[i], n) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/* reason phrase of a status line */
+static const char *status_reason(long status)
+{
+	switch (status)
+	{
+		case 200: return "OK";
+		case 304: return "Not Modified";
+		case 404: return "Not Found";
+		case 429: return "Too Many Requests";
+		case 503: return "Service Unavailable";
+		default: return "Recorded";
+	}
+}
+
+/* answer one request for target */
+static int respond(int fd, const char *target)
+{
+	libcohost_buffer_t head, out, body;
+	const char *line, *end;
+	char status_line[128];
+	long status = 404;
+	int r, ok;
+
+	memset(&head, 0, sizeof(head));
+	memset(&body, 0, sizeof(body));
+	memset(&out, 0, sizeof(out));
+
+	pthread_mutex_lock(&transport_mutex);
+	r = libcohost_transport_load(transport, target, &status, &head, &body);
+	pthread_mutex_unlock(&transport_mutex);
+
+	if (r != LIBCOHOST_RESULT_OK)
+	{
+		status = 404;
+		libcohost_buffer_reset(&head);
+		libcohost_buffer_reset(&body);
+	}
+
+	if (verbose)
+		fprintf(stderr, "%s: %ld %s\n", NAME, status, target);
+
+	snprintf(status_line, sizeof(status_line), "HTTP/1.1 %ld %s\r\nContent-Length: %lu\r\n",
+		status, status_reason(status), (unsigned long)body.len);
+	ok = libcohost_buffer_append(&out, status_line, strlen(status_line)) == LIBCOHOST_RESULT_OK;
+
+	/* pass on the recorded headers that still hold */
+	for (line = head.data; ok && line && *line; line = end)
+	{
+		end = strchr(line, '\n');
+		end = end ? end + 1 : line + strlen(line);
+
+		if (!header_skip(line, end - line))
+			ok = libcohost_buffer_append(&out, line, end - line) == LIBCOHOST_RESULT_OK;
+	}
+
+	ok = ok && libcohost_buffer_append(&out, "\r\n", 2) == LIBCOHOST_RESULT_OK;
+
+	/* simulated round trip */
+	if (latency_ms)
+		usleep(latency_ms * 1000);
+
+	ok = ok && send_all(fd, out.data, out.len) && send_all(fd, body.data, body.len);
+
+	libcohost_buffer_free(&head);
+	libcohost_buffer_free(&body);
+	libcohost_buffer_free(&out);
+
+	return ok;
+}
+
+/* serve one keep-alive connection */
+static void *connection_main(void *data)
+{
+	char request[REQUEST_MAX + 1];
+	char method[16], target[2048];
+	size_t len = 0, used;
+	ssize_t n;
+	char *end;
+	int fd = (int)(intptr_t)data;
+	int close_after;
+
+	for (;;)
+	{
+		/* read until the end of a request head */
+		while ((end = len ? strstr(request, "\r\n\r\n") : NULL) == NULL)
+		{
+			if (len >= REQUEST_MAX)
+				goto done;
+			n = recv(fd, request + len, REQUEST_MAX - len, 0);
+			if (n <= 0)
+				goto done;
+			len += n;
+			request[len] = '\0';
+		}
+
+		used = end + 4 - request;
+
+		if (sscanf(request, "%15s %2047s", method, target) != 2 || strcmp(method, "GET") != 0)
+			goto done;
+
+		close_after = strstr(request, "Connection: close") != NULL;
+
+		if (!respond(fd, target) || close_after)
+			goto done;
+
+		/* keep whatever of the next request already arrived */
+		memmove(request, request + used, len - used);
+		len -= used;
+		request[len] = '\0';
+	}
+
+done:
+	close(fd);
+	return NULL;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: " NAME " [-p port] [-l latency_ms] [-b bytes_per_second] [-v] recordings\n"
+		"serves responses recorded with LIBCOHOST_TRANSPORT_RECORD on 127.0.0.1\n");
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_in addr;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int port = 8080;
+	int fd, client, one = 1, c;
+
+	while ((c = getopt(argc, argv, "p:l:b:v")) != -1)
+	{
+		switch (c)
+		{
+			case 'p': port = atoi(optarg); break;
+			case 'l': latency_ms = strtoul(optarg, NULL, 10); break;
+			case 'b': bandwidth = strtoul(optarg, NULL, 10); break;
+			case 'v': verbose = 1; break;
+			default: usage();
+		}
+	}
+
+	if (optind != argc - 1)
+		usage();
+
+	transport = libcohost_transport_open(argv[optind], LIBCOHOST_TRANSPORT_REPLAY);
+	if (transport == NULL)
+	{
+		fprintf(stderr, "%s: couldn't open %s\n", NAME, argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		perror(NAME);
+		return EXIT_FAILURE;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((unsigned short)port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0)
+	{
+		perror(NAME);
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%s: serving %s on http://127.0.0.1:%d with %lu ms latency\n", NAME, argv[optind], port, latency_ms);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	/* a thread per connection, the client keeps only a handful open */
+	for (;;)
+	{
+		client = accept(fd, NULL, NULL);
+		if (client < 0)
+			continue;
+
+		setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+		if (pthread_create(&thread, &attr, connection_main, (void *)(intptr_t)client) != 0)
+			close(client);
+	}
+
+	return EXIT_SUCCESS;
+}